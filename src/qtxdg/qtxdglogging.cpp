@@ -23,9 +23,13 @@
 #include <QtGlobal>
 
 #if defined(NDEBUG)
+Q_LOGGING_CATEGORY(QtXdgIcon, "qtxdg.icon", QtInfoMsg)
 Q_LOGGING_CATEGORY(QtXdgMimeApps, "qtxdg.mimeapps", QtInfoMsg)
 Q_LOGGING_CATEGORY(QtXdgMimeAppsGLib, "qtxdg.mimeapps.glib", QtInfoMsg)
+Q_LOGGING_CATEGORY(QtXdgMimeAppsNative, "qtxdg.mimeapps.native", QtInfoMsg)
 #else
+Q_LOGGING_CATEGORY(QtXdgIcon, "qtxdg.icon")
 Q_LOGGING_CATEGORY(QtXdgMimeApps, "qtxdg.mimeapps")
 Q_LOGGING_CATEGORY(QtXdgMimeAppsGLib, "qtxdg.mimeapps.glib")
+Q_LOGGING_CATEGORY(QtXdgMimeAppsNative, "qtxdg.mimeapps.native")
 #endif
@@ -23,7 +23,9 @@
 
 #include <QLoggingCategory>
 
+Q_DECLARE_LOGGING_CATEGORY(QtXdgIcon)
 Q_DECLARE_LOGGING_CATEGORY(QtXdgMimeApps)
 Q_DECLARE_LOGGING_CATEGORY(QtXdgMimeAppsGLib)
+Q_DECLARE_LOGGING_CATEGORY(QtXdgMimeAppsNative)
 
 #endif // QTXDGLOGGING_H
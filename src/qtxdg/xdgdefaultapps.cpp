@@ -24,24 +24,29 @@
 #include "xdgdirs.h"
 #include "xdgmimeapps.h"
 
+#include <QCoreApplication>
+#include <QDir>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QMutex>
 #include <QSet>
 #include <QSettings>
 #include <QString>
 #include <QStringList>
 
-#include <memory>
-#include <vector>
+#include <optional>
 
 using namespace Qt::Literals::StringLiterals;
 
-static XdgDesktopFile *getTerminal(const QString &terminalName)
+static XdgDesktopFile getTerminal(const QString &terminalName)
 {
-    XdgDesktopFile *t = new XdgDesktopFile{};
-    if (t->load(terminalName) && t->isValid()) {
-        const QStringList cats = t->value("Categories"_L1, QString()).toString().split(u';', Qt::SkipEmptyParts);
+    XdgDesktopFile t;
+    if (t.load(terminalName) && t.isValid()) {
+        const QStringList cats = t.value("Categories"_L1, QString()).toString().split(u';', Qt::SkipEmptyParts);
         if (cats.contains("TerminalEmulator"_L1)) {
-            if (t->contains("TryExec"_L1)) {
-                if (t->tryExec()) {
+            if (t.contains("TryExec"_L1)) {
+                if (t.tryExec()) {
                     return t;
                 }
             } else {
@@ -50,8 +55,7 @@ static XdgDesktopFile *getTerminal(const QString &terminalName)
         }
     }
 
-    delete t;
-    return nullptr;
+    return XdgDesktopFile();
 }
 
 static QStringList getWebBrowserProtocolsGet()
@@ -88,42 +92,182 @@ static QString qtxdgConfigFilename()
     return QString::fromLocal8Bit(qtxdgConfig);
 }
 
+static QList<XdgDesktopFile *> toPointers(const XdgDesktopFileList &apps)
+{
+    QList<XdgDesktopFile *> dl;
+    dl.reserve(apps.size());
+    for (const XdgDesktopFile &app : apps)
+        dl.append(new XdgDesktopFile(app));
+    return dl;
+}
+
+namespace {
+/*
+ * Remembers the answers of each role. Launching an app with Terminal=true
+ * asks for the terminal every time. Everything is forgotten when the mime
+ * apps change, the desktop file of the terminal may have been installed,
+ * removed or edited. The terminal is also forgotten when qtxdg.conf changes.
+ */
+class DefaultAppsCache
+{
+public:
+    DefaultAppsCache();
+
+    XdgDesktopFile defaultApp(const QString &protocol);
+    bool setDefaultApp(const QString &protocol, const XdgDesktopFile &app);
+    XdgDesktopFileList categoryAndMimeTypeApps(const QString &category, const QStringList &protocols);
+    XdgDesktopFile terminal();
+    bool setTerminal(const XdgDesktopFile &app);
+
+private:
+    void watchConfig();
+    void clearMimeApps();
+    // Without an application nothing delivers the changes, nothing is
+    // remembered then. mMutex must be held.
+    void clearUnlessWatched();
+
+    QMutex mMutex;
+    XdgMimeApps mMimeApps;
+    QFileSystemWatcher mConfigWatcher;
+    const QString mConfigFile;
+    // Invalid if the protocol has no default
+    QHash<QString, XdgDesktopFile> mDefaults;
+    QHash<QString, XdgDesktopFileList> mCategoryApps;
+    std::optional<XdgDesktopFile> mTerminal;
+};
+
+DefaultAppsCache::DefaultAppsCache()
+    : mConfigFile(QSettings(QSettings::UserScope, qtxdgConfigFilename()).fileName())
+{
+    // The watchers need a thread with a running event loop
+    if (QCoreApplication *app = QCoreApplication::instance()) {
+        mMimeApps.moveToThread(app->thread());
+        mConfigWatcher.moveToThread(app->thread());
+    }
+
+    QObject::connect(&mMimeApps, &XdgMimeApps::changed, &mMimeApps, [this] {
+        clearMimeApps();
+    });
+    // Writing the file replaces it, the watch on the file is lost then and
+    // the directory tells when it's back
+    const auto configChanged = [this] {
+        watchConfig();
+        QMutexLocker locker(&mMutex);
+        mTerminal.reset();
+    };
+    QObject::connect(&mConfigWatcher, &QFileSystemWatcher::fileChanged, &mConfigWatcher, configChanged);
+    QObject::connect(&mConfigWatcher, &QFileSystemWatcher::directoryChanged, &mConfigWatcher, configChanged);
+    QMetaObject::invokeMethod(&mConfigWatcher, [this] { watchConfig(); });
+}
+
+// Runs in the thread of mConfigWatcher
+void DefaultAppsCache::watchConfig()
+{
+    const QFileInfo config(mConfigFile);
+    const QStringList watched = mConfigWatcher.files() + mConfigWatcher.directories();
+    QStringList paths;
+    if (!watched.contains(config.path()) && config.dir().exists())
+        paths.append(config.path());
+    if (!watched.contains(mConfigFile) && config.exists())
+        paths.append(mConfigFile);
+    if (!paths.isEmpty())
+        mConfigWatcher.addPaths(paths);
+}
+
+void DefaultAppsCache::clearMimeApps()
+{
+    QMutexLocker locker(&mMutex);
+    mDefaults.clear();
+    mCategoryApps.clear();
+    mTerminal.reset();
+}
+
+void DefaultAppsCache::clearUnlessWatched()
+{
+    if (QCoreApplication::instance() == nullptr) {
+        mDefaults.clear();
+        mCategoryApps.clear();
+        mTerminal.reset();
+    }
+}
+
+XdgDesktopFile DefaultAppsCache::defaultApp(const QString &protocol)
+{
+    QMutexLocker locker(&mMutex);
+    clearUnlessWatched();
+    auto it = mDefaults.constFind(protocol);
+    if (it == mDefaults.constEnd())
+        it = mDefaults.insert(protocol, mMimeApps.defaultAppEntry(protocol));
+    return *it;
+}
+
+bool DefaultAppsCache::setDefaultApp(const QString &protocol, const XdgDesktopFile &app)
+{
+    const bool ok = mMimeApps.setDefaultApp(protocol, app);
+    // Don't wait for the monitor, the next queries must see the change
+    clearMimeApps();
+    return ok;
+}
+
 // returns the list of apps that are from category and support protocols
-static QList<XdgDesktopFile *> categoryAndMimeTypeApps(const QString &category, const QStringList &protocols)
+XdgDesktopFileList DefaultAppsCache::categoryAndMimeTypeApps(const QString &category, const QStringList &protocols)
 {
-    XdgMimeApps db;
-    QList<XdgDesktopFile *> apps = db.categoryApps(category);
-    const QSet<QString> protocolsSet = QSet<QString>(protocols.begin(), protocols.end());
-    QList<XdgDesktopFile*>::iterator it = apps.begin();
-    while (it != apps.end()) {
-        const auto list = (*it)->mimeTypes();
-        const QSet<QString> appSupportsSet = QSet<QString>(list.begin(), list.end());
-        if (appSupportsSet.contains(protocolsSet) && (*it)->isShown()) {
-            ++it;
-        } else {
-            delete *it;
-            it = apps.erase(it);
-        }
+    QMutexLocker locker(&mMutex);
+    clearUnlessWatched();
+    const QString key = category + u'\n' + protocols.join(u';');
+    auto it = mCategoryApps.constFind(key);
+    if (it == mCategoryApps.constEnd()) {
+        XdgDesktopFileList apps = mMimeApps.categoryAppEntries(category);
+        const QSet<QString> protocolsSet = QSet<QString>(protocols.begin(), protocols.end());
+        apps.removeIf([&protocolsSet] (const XdgDesktopFile &app) {
+            const auto list = app.mimeTypes();
+            const QSet<QString> appSupportsSet = QSet<QString>(list.begin(), list.end());
+            return !appSupportsSet.contains(protocolsSet) || !app.isShown();
+        });
+        it = mCategoryApps.insert(key, apps);
     }
-    return apps;
+    return *it;
 }
 
-static XdgDesktopFile *defaultApp(const QString &protocol)
+XdgDesktopFile DefaultAppsCache::terminal()
 {
-    XdgMimeApps db;
-    XdgDesktopFile *app = db.defaultApp(protocol);
-    if (app && app->isValid()) {
-        return app;
-    } else {
-        delete app; // it's fine to delete a nullptr
-        return nullptr;
+    QMutexLocker locker(&mMutex);
+    clearUnlessWatched();
+    if (!mTerminal) {
+        QSettings settings(QSettings::UserScope, qtxdgConfigFilename());
+        const QString terminalName = settings.value("TerminalEmulator"_L1, QString()).toString();
+        mTerminal = getTerminal(terminalName);
     }
+    return *mTerminal;
+}
+
+bool DefaultAppsCache::setTerminal(const XdgDesktopFile &app)
+{
+    {
+        QSettings settings(QSettings::UserScope, qtxdgConfigFilename());
+        settings.setValue("TerminalEmulator"_L1, XdgDesktopFile::id(app.fileName()));
+    }
+    QMutexLocker locker(&mMutex);
+    mTerminal.reset();
+    return true;
+}
+}
+Q_GLOBAL_STATIC(DefaultAppsCache, defaultAppsCache)
+
+static XdgDesktopFile *defaultApp(const QString &protocol)
+{
+    const XdgDesktopFile app = defaultAppsCache()->defaultApp(protocol);
+    return app.isValid() ? new XdgDesktopFile(app) : nullptr;
 }
 
 static bool setDefaultApp(const QString &protocol, const XdgDesktopFile &app)
 {
-    XdgMimeApps db;
-    return db.setDefaultApp(protocol, app);
+    return defaultAppsCache()->setDefaultApp(protocol, app);
+}
+
+static QList<XdgDesktopFile *> categoryAndMimeTypeApps(const QString &category, const QStringList &protocols)
+{
+    return toPointers(defaultAppsCache()->categoryAndMimeTypeApps(category, protocols));
 }
 
 XdgDesktopFile *XdgDefaultApps::emailClient()
@@ -161,10 +305,7 @@ bool XdgDefaultApps::setTerminal(const XdgDesktopFile &app)
     if (!app.isValid())
         return false;
 
-    const QString configFile = qtxdgConfigFilename();
-    QSettings settings(QSettings::UserScope, configFile);
-    settings.setValue("TerminalEmulator"_L1, XdgDesktopFile::id(app.fileName()));
-    return true;
+    return defaultAppsCache()->setTerminal(app);
 }
 
 bool XdgDefaultApps::setWebBrowser(const XdgDesktopFile &app)
@@ -181,26 +322,13 @@ bool XdgDefaultApps::setWebBrowser(const XdgDesktopFile &app)
 
 XdgDesktopFile *XdgDefaultApps::terminal()
 {
-    const QString configFile = qtxdgConfigFilename();
-    QSettings settings(QSettings::UserScope, configFile);
-    const QString terminalName = settings.value("TerminalEmulator"_L1, QString()).toString();
-    return getTerminal(terminalName);
+    const XdgDesktopFile t = defaultAppsCache()->terminal();
+    return t.isValid() ? new XdgDesktopFile(t) : nullptr;
 }
 
 QList<XdgDesktopFile *> XdgDefaultApps::terminals()
 {
-    XdgMimeApps db;
-    QList<XdgDesktopFile *> terminalList = db.categoryApps("TerminalEmulator"_L1);
-    QList<XdgDesktopFile *>::iterator it = terminalList.begin();
-    while (it != terminalList.end()) {
-        if ((*it)->isShown()) {
-            ++it;
-        } else {
-            delete *it;
-            it = terminalList.erase(it);
-        }
-    }
-    return terminalList;
+    return categoryAndMimeTypeApps("TerminalEmulator"_L1, QStringList());
 }
 
 // To be qualified as the default browser all protocols must be set to the same
@@ -208,22 +336,14 @@ QList<XdgDesktopFile *> XdgDefaultApps::terminals()
 XdgDesktopFile *XdgDefaultApps::webBrowser()
 {
     const QStringList webBrowserProtocolsGet = getWebBrowserProtocolsGet();
-        std::vector<std::unique_ptr<XdgDesktopFile>> apps;
-    for (int i = 0; i < webBrowserProtocolsGet.count(); ++i) {
-        auto a = std::unique_ptr<XdgDesktopFile>(defaultApp(webBrowserProtocolsGet.at(i)));
-        apps.push_back(std::move(a));
-        if (apps.at(i) && apps.at(i)->isValid())
-            continue;
-        else
-            return nullptr;
-    }
-
-    // At this point all apps are non null and valid
-    for (int i = 1; i < webBrowserProtocolsGet.count(); ++i) {
-        if (*apps.at(i - 1) != *apps.at(i))
+    XdgDesktopFile app;
+    for (const QString &protocol : webBrowserProtocolsGet) {
+        const XdgDesktopFile a = defaultAppsCache()->defaultApp(protocol);
+        if (!a.isValid() || (app.isValid() && app != a))
             return nullptr;
+        app = a;
     }
-    return new XdgDesktopFile(*apps.at(0).get());
+    return new XdgDesktopFile(app);
 }
 
 QList<XdgDesktopFile *> XdgDefaultApps::webBrowsers()
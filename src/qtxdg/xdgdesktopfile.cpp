@@ -51,6 +51,7 @@
 #include <QList>
 #include <QMimeDatabase>
 #include <QMimeType>
+#include <QMutex>
 #include <QProcess>
 #include <QRegularExpression>
 #include <QSettings>
@@ -87,6 +88,10 @@ static constexpr QLatin1StringView execKey("Exec");
 static constexpr QLatin1StringView urlKey("URL");
 static constexpr QLatin1StringView iconKey("Icon");
 
+// Guards the memoized isShown() results: the parsed files are shared
+// between threads by the mime apps cache
+static QBasicMutex isShownMutex;
+
 // Helper functions prototypes
 QString &doEscape(QString& str, const QHash<QChar,QChar> &repl);
 QString &doSimpleUnEscape(QString& str, const QHash<QChar,QChar> &repl);
@@ -616,10 +621,10 @@ bool XdgDesktopFileData::startLinkDetached(const XdgDesktopFile *q) const
         QMimeDatabase db;
         XdgMimeApps appsDb;
         QMimeType mimeInfo = db.mimeTypeForFile(fi);
-        XdgDesktopFile* desktopFile = appsDb.defaultApp(mimeInfo.name());
+        const XdgDesktopFile desktopFile = appsDb.defaultAppEntry(mimeInfo.name());
 
-        if (desktopFile)
-            return desktopFile->startDetached(url);
+        if (desktopFile.isValid())
+            return desktopFile.startDetached(url);
     }
     else
     {
@@ -1349,21 +1354,20 @@ bool XdgDesktopFile::isShown(const QString &environment) const
 {
     const QString env = environment.toUpper();
 
-    if (d->mIsShow.contains(env))
-        return d->mIsShow.value(env);
-
-    d->mIsShow.insert(env, false);
-
-    // Means "this application exists, but don't display it in the menus".
-    if (value("NoDisplay"_L1).toBool())
-        return false;
+    {
+        QMutexLocker locker(&isShownMutex);
+        const auto it = d->mIsShow.constFind(env);
+        if (it != d->mIsShow.constEnd())
+            return *it;
+    }
 
-    // The file is not suitable to the current environment
-    if (!isSuitable(true, env))
-        return false;
+    // NoDisplay means "this application exists, but don't display it in the
+    // menus". Otherwise the file must suit the current environment.
+    const bool shown = !value("NoDisplay"_L1).toBool() && isSuitable(true, env);
 
-    d->mIsShow.insert(env, true);
-    return true;
+    QMutexLocker locker(&isShownMutex);
+    d->mIsShow.insert(env, shown);
+    return shown;
 }
 
 
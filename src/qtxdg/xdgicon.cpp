@@ -34,7 +34,13 @@
 #include <QStringList>
 #include <QFileInfo>
 #include <QCache>
+#include <QDataStream>
+#include <QIconEngine>
+#include <QImageReader>
+#include <QMutex>
+#include <QPainter>
 #include "../xdgiconloader/xdgiconloader_p.h"
+#include "qtxdglogging.h"
 #include <QCoreApplication>
 
 using namespace Qt::Literals::StringLiterals;
@@ -42,15 +48,50 @@ using namespace Qt::Literals::StringLiterals;
 static constexpr QLatin1StringView DEFAULT_APP_ICON("application-x-executable");
 
 static void qt_cleanup_icon_cache();
-typedef QCache<QString, QIcon> IconCache;
 
 namespace {
-struct QtIconCache: public IconCache
+/*
+ * The icons handed out by fromTheme(), by name. The cost of an icon is the
+ * memory it holds, in bytes: the engine and its entries for a theme icon,
+ * the pixmap it keeps once painted for a file. The least recently used ones
+ * are evicted when the budget is exceeded. The cache is flushed when the
+ * icon theme changes. Statistics are logged to the "qtxdg.icon" category.
+ *
+ * A theme icon is resolved at its first use, after it's cached. It's
+ * charged its engine only until then, and its entries at the next hit.
+ *
+ * fromTheme() may be called from any thread.
+ */
+class IconCache
 {
-    QtIconCache()
+public:
+    IconCache()
     {
         qAddPostRoutine(qt_cleanup_icon_cache);
     }
+
+    QIcon icon(const QString &iconName);
+    void clear();
+    int limit() const;
+    void setLimit(int kb);
+
+private:
+    struct CachedIcon
+    {
+        QIcon icon;
+        // The cost includes the entries of the resolved icon
+        bool charged;
+    };
+
+    void insert(const QString &key, const QIcon &icon, qsizetype cost, bool charged);
+    void logStatistics() const;
+
+    mutable QMutex m_mutex;
+    QCache<QString, CachedIcon> m_icons{512 * 1024};
+    uint m_key = 0;
+    qint64 m_hits = 0;
+    qint64 m_misses = 0;
+    qint64 m_evictions = 0;
 };
 }
 Q_GLOBAL_STATIC(IconCache, qtIconCache)
@@ -61,12 +102,258 @@ static void qt_cleanup_icon_cache()
 }
 
 
+// Strips the path and the file extension, if any
+static QString themeIconName(const QString &iconName)
+{
+    QString name = QFileInfo(iconName).fileName();
+    if (name.endsWith(".png"_L1, Qt::CaseInsensitive) ||
+        name.endsWith(".svg"_L1, Qt::CaseInsensitive) ||
+        name.endsWith(".xpm"_L1, Qt::CaseInsensitive))
+    {
+        name.truncate(name.length() - 4);
+    }
+    return name;
+}
+
+
 XdgIcon::XdgIcon() = default;
 
 
 XdgIcon::~XdgIcon() = default;
 
 
+namespace {
+/*
+ * Stands for the first candidate icon that is found in the theme, or for the
+ * fallback icon. The choice is made at the first paint or query, so that
+ * creating the icon doesn't search the theme; big menus then only resolve
+ * the icons they show. It's made again when the theme changes.
+ *
+ * The engine isn't known to the icon engine plugins, so it's serialized as
+ * the icon chosen: the stream reads back that icon.
+ */
+class XdgFallbackIconEngine : public QIconEngine
+{
+public:
+    XdgFallbackIconEngine(const QStringList &candidates, const QIcon &fallback)
+        : m_candidates(candidates), m_fallback(fallback)
+    {
+    }
+
+    void paint(QPainter *painter, const QRect &rect, QIcon::Mode mode, QIcon::State state) override
+    {
+        current().paint(painter, rect, Qt::AlignCenter, mode, state);
+    }
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state) override
+    {
+        return current().pixmap(size, mode, state);
+    }
+    QPixmap scaledPixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale) override
+    {
+        return current().pixmap(size, scale, mode, state);
+    }
+    QSize actualSize(const QSize &size, QIcon::Mode mode, QIcon::State state) override
+    {
+        return current().actualSize(size, mode, state);
+    }
+    QList<QSize> availableSizes(QIcon::Mode mode, QIcon::State state) override
+    {
+        return current().availableSizes(mode, state);
+    }
+    QString iconName() override { return current().name(); }
+    bool isNull() override { return current().isNull(); }
+    QString key() const override;
+    bool write(QDataStream &out) const override;
+    QIconEngine *clone() const override { return new XdgFallbackIconEngine(m_candidates, m_fallback); }
+
+private:
+    QIcon current() const;
+    QByteArray serialized(int version) const;
+
+    const QStringList m_candidates;
+    const QIcon m_fallback;
+    // Icons are shared between threads, guards the choice
+    mutable QMutex m_mutex;
+    mutable QIcon m_current;
+    mutable uint m_key = 0;
+    mutable uint m_generation = 0;
+    mutable bool m_chosen = false;
+};
+}
+
+// The memory held by the icon of a file once it's painted. Reads the image
+// header, not to be called under the lock.
+static qsizetype fileIconCost(const QString &fileName)
+{
+    const QSize size = QImageReader(fileName).size();
+    if (size.isValid())
+        return sizeof(QIcon) + qsizetype(size.width()) * size.height() * 4;
+    return sizeof(QIcon) + fileName.size() * qsizetype(sizeof(QChar));
+}
+
+// Returns the cached icon of iconName, without looking it up in the theme
+QIcon IconCache::icon(const QString &iconName)
+{
+    const bool isAbsolute = (iconName[0] == u'/');
+    const QString key = !isAbsolute ? themeIconName(iconName) : iconName;
+    XdgIconLoader *loader = XdgIconLoader::instance();
+
+    QMutexLocker locker(&m_mutex);
+    // The engines of the old theme would just reload themselves
+    const uint themeKey = loader->themeKey();
+    if (m_key != themeKey)
+    {
+        if (!m_icons.isEmpty())
+        {
+            qCDebug(QtXdgIcon, "Icon theme changed, dropping %lld cached icons", qint64(m_icons.size()));
+            m_icons.clear();
+        }
+        m_key = themeKey;
+    }
+
+    if (const CachedIcon *cached = m_icons.object(key))
+    {
+        ++m_hits;
+        const QIcon icon = cached->icon;
+        if (!cached->charged)
+        {
+            bool resolved = false;
+            const qsizetype cost = sizeof(QIcon) + loader->engineCost(key, &resolved);
+            if (resolved)
+                insert(key, icon, cost, true);
+        }
+        return icon;
+    }
+
+    QIcon icon;
+    qsizetype cost;
+    bool charged = true;
+    if (isAbsolute)
+    {
+        locker.unlock();
+        icon = QIcon(iconName);
+        cost = fileIconCost(iconName);
+        locker.relock();
+    }
+    else
+    {
+        icon = QIcon(new XdgIconLoaderEngine(key));
+        cost = sizeof(QIcon) + loader->engineCost(key, &charged);
+    }
+    insert(key, icon, cost, charged);
+    if (++m_misses % 256 == 0)
+        logStatistics();
+    return icon;
+}
+
+// m_mutex must be held
+void IconCache::insert(const QString &key, const QIcon &icon, qsizetype cost, bool charged)
+{
+    const qsizetype count = m_icons.size() - (m_icons.contains(key) ? 1 : 0);
+    m_icons.insert(key, new CachedIcon{icon, charged}, cost);
+    m_evictions += count + 1 - m_icons.size();
+}
+
+void IconCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    logStatistics();
+    m_icons.clear();
+}
+
+int IconCache::limit() const
+{
+    QMutexLocker locker(&m_mutex);
+    return int(m_icons.maxCost() / 1024);
+}
+
+void IconCache::setLimit(int kb)
+{
+    QMutexLocker locker(&m_mutex);
+    const qsizetype count = m_icons.size();
+    m_icons.setMaxCost(qsizetype(kb) * 1024);
+    m_evictions += count - m_icons.size();
+}
+
+// m_mutex must be held
+void IconCache::logStatistics() const
+{
+    qCDebug(QtXdgIcon, "Icon cache: %lld hits, %lld misses, %lld evictions, %lld icons, %lld of %lld bytes",
+            m_hits, m_misses, m_evictions, qint64(m_icons.size()),
+            qint64(m_icons.totalCost()), qint64(m_icons.maxCost()));
+}
+
+QIcon XdgFallbackIconEngine::current() const
+{
+    QMutexLocker locker(&m_mutex);
+    const uint key = XdgIconLoader::instance()->themeKey();
+    // Some icons were invalidated, the candidates may be found differently
+    const uint generation = XdgIconLoader::instance()->generation();
+    if (m_chosen && m_key == key && m_generation == generation)
+        return m_current;
+
+    // Search the theme names up to the first file at once, the loop below
+    // then finds them resolved
+    QStringList themeNames;
+    for (const QString &iconName : m_candidates)
+    {
+        if (iconName[0] == u'/')
+            break;
+        themeNames.append(themeIconName(iconName));
+    }
+    if (themeNames.size() > 1)
+        XdgIconLoader::instance()->resolveFirst(themeNames);
+
+    m_current = m_fallback;
+    for (const QString &iconName : m_candidates)
+    {
+        const QIcon icon = qtIconCache()->icon(iconName);
+        // Files are taken as they are, theme icons need to be found
+        const bool found = iconName[0] == u'/' ? !icon.isNull() : !icon.availableSizes().isEmpty();
+        if (found)
+        {
+            m_current = icon;
+            break;
+        }
+    }
+    m_key = key;
+    m_generation = generation;
+    m_chosen = true;
+    return m_current;
+}
+
+// What QIcon writes for the icon chosen: the key of its engine, then the
+// data of the engine
+QByteArray XdgFallbackIconEngine::serialized(int version) const
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(version);
+    out << current();
+    return data;
+}
+
+QString XdgFallbackIconEngine::key() const
+{
+    QDataStream in(serialized(QDataStream::Qt_DefaultCompiledVersion));
+    QString key;
+    in >> key;
+    return key;
+}
+
+bool XdgFallbackIconEngine::write(QDataStream &out) const
+{
+    // QIcon wrote key() already
+    const QByteArray data = serialized(out.version());
+    QDataStream in(data);
+    in.setVersion(out.version());
+    QString key;
+    in >> key;
+    const qint64 offset = in.device()->pos();
+    return out.writeRawData(data.constData() + offset, int(data.size() - offset)) == data.size() - offset;
+}
+
+
 /************************************************
  Returns the QIcon corresponding to name in the current icon theme. If no such icon
  is found in the current theme fallback is return instead.
@@ -76,56 +363,78 @@ QIcon XdgIcon::fromTheme(const QString& iconName, const QIcon& fallback)
     if (iconName.isEmpty())
         return fallback;
 
-    bool isAbsolute = (iconName[0] == u'/');
+    // The icon of a file has no fallback. The icon of a missing theme name
+    // is null already, the lookup is left to the first use of the icon.
+    if (iconName[0] == u'/' || fallback.isNull())
+        return qtIconCache()->icon(iconName);
 
-    QString name = QFileInfo(iconName).fileName();
-    if (name.endsWith(".png"_L1, Qt::CaseInsensitive) ||
-        name.endsWith(".svg"_L1, Qt::CaseInsensitive) ||
-        name.endsWith(".xpm"_L1, Qt::CaseInsensitive))
+    return QIcon(new XdgFallbackIconEngine(QStringList(iconName), fallback));
+}
+
+
+/************************************************
+ Returns the QIcon corresponding to names in the current icon theme. If no such icon
+ is found in the current theme fallback is return instead.
+ ************************************************/
+QIcon XdgIcon::fromTheme(const QStringList& iconNames, const QIcon& fallback)
+{
+    QStringList candidates;
+    candidates.reserve(iconNames.size());
+    for (const QString &iconName : iconNames)
     {
-        name.truncate(name.length() - 4);
+        if (!iconName.isEmpty())
+            candidates.append(iconName);
     }
 
-    QIcon icon;
+    if (candidates.isEmpty())
+        return fallback;
+    if (candidates.size() == 1)
+        return fromTheme(candidates.first(), fallback);
+    return QIcon(new XdgFallbackIconEngine(candidates, fallback));
+}
 
-    if (!isAbsolute ? qtIconCache()->contains(name) : qtIconCache()->contains(iconName)) {
-        icon = *qtIconCache()->object(!isAbsolute ? name : iconName);
-    } else {
-        QIcon *cachedIcon;
-        if (!isAbsolute) {
-            cachedIcon = new QIcon(new XdgIconLoaderEngine(name));
-            qtIconCache()->insert(name, cachedIcon);
-        } else {
-            cachedIcon = new QIcon(iconName);
-            qtIconCache()->insert(iconName, cachedIcon);
-        }
-        icon = *cachedIcon;
-    }
 
+/************************************************
+ Returns the QIcons corresponding to iconNames in the current icon theme. The
+ names are resolved all at once, the icons that aren't found are replaced by
+ fallback.
+ ************************************************/
+QList<QIcon> XdgIcon::fromThemeBatch(const QStringList& iconNames, const QIcon& fallback)
+{
     // Note the qapp check is to allow lazy loading of static icons
-    // Supporting fallbacks will not work for this case.
-    if (qApp && !isAbsolute && icon.availableSizes().isEmpty())
+    if (qApp)
     {
-        return fallback;
+        QStringList names;
+        names.reserve(iconNames.size());
+        for (const QString &iconName : iconNames)
+        {
+            if (!iconName.isEmpty() && iconName[0] != u'/')
+                names.append(themeIconName(iconName));
+        }
+        names.removeDuplicates();
+        XdgIconLoader::instance()->resolve(names);
     }
-    return icon;
+
+    // The icons only pick up the resolved names now
+    QList<QIcon> icons;
+    icons.reserve(iconNames.size());
+    for (const QString &iconName : iconNames)
+        icons.append(fromTheme(iconName, fallback));
+    return icons;
 }
 
 
-/************************************************
- Returns the QIcon corresponding to names in the current icon theme. If no such icon
- is found in the current theme fallback is return instead.
- ************************************************/
-QIcon XdgIcon::fromTheme(const QStringList& iconNames, const QIcon& fallback)
+void XdgIcon::prewarm(const QStringList& iconNames, const QList<int>& sizes)
 {
+    QStringList names;
+    names.reserve(iconNames.size());
     for (const QString &iconName : iconNames)
     {
-        QIcon icon = fromTheme(iconName);
-        if (!icon.isNull())
-            return icon;
+        if (!iconName.isEmpty() && iconName[0] != u'/')
+            names.append(themeIconName(iconName));
     }
 
-    return fallback;
+    XdgIconLoader::instance()->prewarm(names, sizes);
 }
 
 
@@ -157,6 +466,42 @@ void XdgIcon::setFollowColorScheme(bool enable)
 }
 
 
+int XdgIcon::cacheLimit()
+{
+    return qtIconCache()->limit();
+}
+
+
+void XdgIcon::setCacheLimit(int kb)
+{
+    qtIconCache()->setLimit(kb);
+}
+
+
+bool XdgIcon::diskCacheEnabled()
+{
+    return XdgIconLoader::instance()->diskCacheEnabled();
+}
+
+
+void XdgIcon::setDiskCacheEnabled(bool enable)
+{
+    XdgIconLoader::instance()->setDiskCacheEnabled(enable);
+}
+
+
+int XdgIcon::diskCacheLimit()
+{
+    return XdgIconLoader::instance()->diskCacheLimit();
+}
+
+
+void XdgIcon::setDiskCacheLimit(int kb)
+{
+    XdgIconLoader::instance()->setDiskCacheLimit(kb);
+}
+
+
 QIcon XdgIcon::defaultApplicationIcon()
 {
     return fromTheme(DEFAULT_APP_ICON);
@@ -44,6 +44,24 @@ public:
                            const QString &fallbackIcon4 = QString());
     static QIcon fromTheme(const QStringList& iconNames, const QIcon& fallback = QIcon());
 
+    /*!
+     * Returns the icons of \a iconNames, in the same order, like calling
+     * fromTheme() for each of them. The names are looked up in the theme in
+     * parallel, which is much faster for many icons, e.g. for building the
+     * application menu. Icons that aren't found are replaced by \a fallback.
+     */
+    static QList<QIcon> fromThemeBatch(const QStringList& iconNames, const QIcon& fallback = QIcon());
+
+    /*!
+     * Looks up \a iconNames in the current icon theme on a worker thread, so
+     * that fromTheme() doesn't have to search the theme the first time the
+     * icons are painted. If \a sizes isn't empty, the icons are also
+     * rendered in these sizes ahead of time.
+     *
+     * Absolute file names are ignored. Must be called from the GUI thread.
+     */
+    static void prewarm(const QStringList& iconNames, const QList<int>& sizes = QList<int>());
+
     /*!
      * Flag if the "FollowsColorScheme" hint (the KDE extension to XDG
      * themes) should be honored. If enabled and the icon theme supports
@@ -54,6 +72,39 @@ public:
      */
     static bool followColorScheme();
     static void setFollowColorScheme(bool enable);
+
+    /*!
+     * The memory budget, in kilobytes, of the icons kept by fromTheme() for
+     * the next calls with the same name. The least recently used icons are
+     * dropped when it's exceeded. The default is 512 KB.
+     *
+     * A theme icon is charged its engine and the files it found; its
+     * rendered pixmaps are shared in QPixmapCache, they aren't counted. The
+     * icon of a file is charged the pixmap it keeps once it's painted.
+     */
+    static int cacheLimit();
+    static void setCacheLimit(int kb);
+
+    /*!
+     * Flag if the rendered icons should also be cached on disk, in
+     * $XDG_CACHE_HOME/qtxdg/icons. The cache is shared by all the
+     * applications of the user, an icon rendered by one of them is loaded
+     * by the others without decoding or rendering it again.
+     *
+     * Default is false.
+     */
+    static bool diskCacheEnabled();
+    static void setDiskCacheEnabled(bool enable);
+
+    /*!
+     * The size limit, in kilobytes, of the disk cache. The least recently
+     * used icons are removed from it once it's exceeded, which is checked
+     * when the cache gets enabled and then regularly while it's written.
+     * The default is 65536 KB.
+     */
+    static int diskCacheLimit();
+    static void setDiskCacheLimit(int kb);
+
     /* TODO: deprecate & remove all QIcon wrappers */
     static QString themeName() { return QIcon::themeName(); }
     static void setThemeName(const QString& themeName) { QIcon::setThemeName(themeName); }
@@ -24,33 +24,94 @@
 #include "xdgdesktopfile.h"
 #include "xdgmacros.h"
 #include "xdgmimeappsglibbackend.h"
+#include "xdgmimeappsnativebackend.h"
 
+#include <QCoreApplication>
+#include <QMetaMethod>
+#include <QMutex>
 #include <QMutexLocker>
 #include <QString>
+#include <QThread>
 #include <QDebug>
 
 using namespace Qt::Literals::StringLiterals;
 
-XdgMimeAppsPrivate::XdgMimeAppsPrivate()
-    : mBackend(nullptr)
+XdgMimeAppsPrivate::XdgMimeAppsPrivate() = default;
+
+static XdgMimeApps::Backend defaultBackend()
 {
+    const QByteArray name = qgetenv("QTXDG_MIMEAPPS_BACKEND");
+    if (name == "native")
+        return XdgMimeApps::NativeBackend;
+    return XdgMimeApps::GLibBackend;
 }
 
-void XdgMimeAppsPrivate::init()
+namespace {
+/*
+ * The backends shared by the XdgMimeApps objects, one of each kind. A
+ * backend is created with the first object using it and deleted with the
+ * last one, the objects only forward its changed() signal. The backends
+ * are thread safe.
+ */
+class SharedBackends
+{
+public:
+    std::shared_ptr<XdgMimeAppsBackendInterface> acquire(XdgMimeApps::Backend backend)
+    {
+        QMutexLocker locker(&mMutex);
+        std::weak_ptr<XdgMimeAppsBackendInterface> &shared = mBackends[backend];
+        std::shared_ptr<XdgMimeAppsBackendInterface> instance = shared.lock();
+        if (!instance) {
+            XdgMimeAppsBackendInterface *b;
+            if (backend == XdgMimeApps::NativeBackend)
+                b = new XdgMimeAppsNativeBackend(nullptr);
+            else
+                b = new XdgMimeAppsGLibBackend(nullptr);
+            // The watchers of the backends need a thread with a running
+            // event loop
+            if (QCoreApplication *app = QCoreApplication::instance())
+                b->moveToThread(app->thread());
+            instance.reset(b, [] (XdgMimeAppsBackendInterface *b) {
+                if (b->thread() == QThread::currentThread())
+                    delete b;
+                else
+                    b->deleteLater();
+            });
+            shared = instance;
+        }
+        return instance;
+    }
+
+private:
+    QMutex mMutex;
+    std::weak_ptr<XdgMimeAppsBackendInterface> mBackends[XdgMimeApps::NativeBackend + 1];
+};
+}
+Q_GLOBAL_STATIC(SharedBackends, sharedBackends)
+
+void XdgMimeAppsPrivate::init(XdgMimeApps::Backend backend)
 {
     Q_Q(XdgMimeApps);
-    mBackend = new XdgMimeAppsGLibBackend(q);
-    QObject::connect(mBackend, &XdgMimeAppsBackendInterface::changed, q, [=] () {
+    if (backend == XdgMimeApps::DefaultBackend)
+        backend = defaultBackend();
+    mBackend = sharedBackends()->acquire(backend);
+    QObject::connect(mBackend.get(), &XdgMimeAppsBackendInterface::changed, q, [=] () {
         Q_EMIT q->changed();
     });
+    QObject::connect(mBackend.get(), &XdgMimeAppsBackendInterface::appsChanged, q, &XdgMimeApps::appsChanged);
 }
 
 XdgMimeAppsPrivate::~XdgMimeAppsPrivate() = default;
 
 XdgMimeApps::XdgMimeApps(QObject *parent)
+    : XdgMimeApps(DefaultBackend, parent)
+{
+}
+
+XdgMimeApps::XdgMimeApps(Backend backend, QObject *parent)
     : QObject(*new XdgMimeAppsPrivate, parent)
 {
-    d_func()->init();
+    d_func()->init(backend);
 }
 
 XdgMimeApps::~XdgMimeApps() = default;
@@ -61,72 +122,98 @@ bool XdgMimeApps::addSupport(const QString &mimeType, const XdgDesktopFile &app)
     if (mimeType.isEmpty() || !app.isValid())
         return false;
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->addAssociation(mimeType, app);
 }
 
+// The copies share the parsed data with the entries
+static QList<XdgDesktopFile *> toPointers(const XdgDesktopFileList &entries)
+{
+    QList<XdgDesktopFile *> dl;
+    dl.reserve(entries.size());
+    for (const XdgDesktopFile &df : entries)
+        dl.append(new XdgDesktopFile(df));
+    return dl;
+}
+
 QList<XdgDesktopFile *> XdgMimeApps::allApps()
+{
+    return toPointers(allAppEntries());
+}
+
+QList<XdgDesktopFile *> XdgMimeApps::apps(const QString &mimeType)
+{
+    return toPointers(appEntries(mimeType));
+}
+
+QList<XdgDesktopFile *> XdgMimeApps::categoryApps(const QString &category)
+{
+    return toPointers(categoryAppEntries(category));
+}
+
+QList<XdgDesktopFile *> XdgMimeApps::fallbackApps(const QString &mimeType)
+{
+    return toPointers(fallbackAppEntries(mimeType));
+}
+
+QList<XdgDesktopFile *> XdgMimeApps::recommendedApps(const QString &mimeType)
+{
+    return toPointers(recommendedAppEntries(mimeType));
+}
+
+XdgDesktopFile *XdgMimeApps::defaultApp(const QString &mimeType)
+{
+    const XdgDesktopFile df = defaultAppEntry(mimeType);
+    return df.isValid() ? new XdgDesktopFile(df) : nullptr;
+}
+
+XdgDesktopFileList XdgMimeApps::allAppEntries()
 {
     Q_D(XdgMimeApps);
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->allApps();
 }
 
-QList<XdgDesktopFile *> XdgMimeApps::apps(const QString &mimeType)
+XdgDesktopFileList XdgMimeApps::appEntries(const QString &mimeType)
 {
     Q_D(XdgMimeApps);
     if (mimeType.isEmpty())
-        return QList<XdgDesktopFile *>();
+        return XdgDesktopFileList();
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->apps(mimeType);
 }
 
-QList<XdgDesktopFile *> XdgMimeApps::categoryApps(const QString &category)
+XdgDesktopFileList XdgMimeApps::categoryAppEntries(const QString &category)
 {
+    Q_D(XdgMimeApps);
     if (category.isEmpty())
-        return QList<XdgDesktopFile *>();
-
-    const QString cat = category.toUpper();
-    const QList <XdgDesktopFile *> apps = allApps();
-    QList <XdgDesktopFile *> dl;
-    for (XdgDesktopFile * const df : apps) {
-        const QStringList categories = df->value("Categories"_L1).toString().toUpper().split(u';');
-        if (!categories.isEmpty() && (categories.contains(cat) || categories.contains("X-"_L1 + cat)))
-            dl.append(df);
-        else
-            delete df;
-    }
-    return dl;
+        return XdgDesktopFileList();
+
+    return d->mBackend->categoryApps(category);
 }
 
-QList<XdgDesktopFile *> XdgMimeApps::fallbackApps(const QString &mimeType)
+XdgDesktopFileList XdgMimeApps::fallbackAppEntries(const QString &mimeType)
 {
     Q_D(XdgMimeApps);
     if (mimeType.isEmpty())
-        return QList<XdgDesktopFile *>();
+        return XdgDesktopFileList();
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->fallbackApps(mimeType);
 }
 
-QList<XdgDesktopFile *> XdgMimeApps::recommendedApps(const QString &mimeType)
+XdgDesktopFileList XdgMimeApps::recommendedAppEntries(const QString &mimeType)
 {
     Q_D(XdgMimeApps);
     if (mimeType.isEmpty())
-        return QList<XdgDesktopFile *>();
+        return XdgDesktopFileList();
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->recommendedApps(mimeType);
 }
 
-XdgDesktopFile *XdgMimeApps::defaultApp(const QString &mimeType)
+XdgDesktopFile XdgMimeApps::defaultAppEntry(const QString &mimeType)
 {
     Q_D(XdgMimeApps);
     if (mimeType.isEmpty())
-        return nullptr;
+        return XdgDesktopFile();
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->defaultApp(mimeType);
 }
 
@@ -136,7 +223,6 @@ bool XdgMimeApps::removeSupport(const QString &mimeType, const XdgDesktopFile &a
     if (mimeType.isEmpty() || !app.isValid())
         return false;
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->removeAssociation(mimeType, app);
 }
 
@@ -146,7 +232,6 @@ bool XdgMimeApps::reset(const QString &mimeType)
     if (mimeType.isEmpty())
         return false;
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->reset(mimeType);
 }
 
@@ -159,8 +244,15 @@ bool XdgMimeApps::setDefaultApp(const QString &mimeType, const XdgDesktopFile &a
     if (XdgDesktopFile::id(app.fileName()).isEmpty())
         return false;
 
-    QMutexLocker locker(&d->mutex);
     return d->mBackend->setDefaultApp(mimeType, app);
 }
 
+void XdgMimeApps::connectNotify(const QMetaMethod &signal)
+{
+    Q_D(XdgMimeApps);
+    // Comparing costs, the backend only does it for the listeners
+    if (signal == QMetaMethod::fromSignal(&XdgMimeApps::appsChanged))
+        d->mBackend->trackChanges();
+}
+
 #include "moc_xdgmimeapps.cpp"
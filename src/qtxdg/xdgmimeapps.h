@@ -24,8 +24,8 @@
 #include <QObject>
 
 #include "xdgmacros.h"
+#include "xdgdesktopfile.h"
 
-class XdgDesktopFile;
 class XdgMimeAppsPrivate;
 
 class QString;
@@ -39,11 +39,33 @@ class QTXDG_API XdgMimeApps : public QObject {
     Q_DECLARE_PRIVATE(XdgMimeApps)
 
 public:
+    /*!
+     * \brief The implementations of the queries
+     *
+     * GLibBackend asks GIO. NativeBackend reads mimeapps.list, defaults.list
+     * and mimeinfo.cache itself, without initializing GIO. DefaultBackend is
+     * the one named by the QTXDG_MIMEAPPS_BACKEND environment variable,
+     * "glib" or "native", and GLibBackend if it isn't set.
+     */
+    enum Backend {
+        DefaultBackend,
+        GLibBackend,
+        NativeBackend
+    };
+    Q_ENUM(Backend)
+
     /*!
      * \brief XdgMimeApps constructor
      */
     explicit XdgMimeApps(QObject *parent = nullptr);
 
+    /*!
+     * \brief XdgMimeApps constructor
+     * \param backend the implementation to use
+     * \param parent
+     */
+    explicit XdgMimeApps(Backend backend, QObject *parent = nullptr);
+
     /*!
       * \brief XdgMimeApps destructor
       */
@@ -98,6 +120,51 @@ public:
      */
     XdgDesktopFile *defaultApp(const QString &mimeType);
 
+    /*!
+     * \brief allAppEntries
+     * The *Entries() functions answer like the functions returning
+     * XdgDesktopFile pointers, but the entries are shared with the cache of
+     * the backend. Repeated queries don't parse nor allocate desktop files,
+     * and there's nothing to delete.
+     * \return
+     */
+    XdgDesktopFileList allAppEntries();
+
+    /*!
+     * \brief appEntries
+     * \param mimeType
+     * \return
+     */
+    XdgDesktopFileList appEntries(const QString &mimeType);
+
+    /*!
+     * \brief categoryAppEntries
+     * \param category
+     * \return
+     */
+    XdgDesktopFileList categoryAppEntries(const QString &category);
+
+    /*!
+     * \brief fallbackAppEntries
+     * \param mimeType
+     * \return
+     */
+    XdgDesktopFileList fallbackAppEntries(const QString &mimeType);
+
+    /*!
+     * \brief recommendedAppEntries
+     * \param mimeType
+     * \return
+     */
+    XdgDesktopFileList recommendedAppEntries(const QString &mimeType);
+
+    /*!
+     * \brief defaultAppEntry
+     * \param mimeType
+     * \return the default app, invalid if there's none
+     */
+    XdgDesktopFile defaultAppEntry(const QString &mimeType);
+
     /*!
      * \brief removeSupport
      * \param mimeType
@@ -123,6 +190,23 @@ public:
 
 Q_SIGNALS:
     void changed();
+
+    /*!
+     * \brief Tells what changed, emitted after changed()
+     * The backend starts keeping what it needs to compare once this signal
+     * is connected. It isn't emitted if none of the lists has something.
+     * \param added the desktop ids of the installed apps
+     * \param removed the desktop ids of the uninstalled apps
+     * \param modified the desktop ids of the apps with another desktop file
+     * \param mimeTypes the types whose associations changed, their subclasses
+     * may answer differently too. With GLibBackend, only the ones queried
+     * since the last change and the types of the changed apps are known.
+     */
+    void appsChanged(const QStringList &added, const QStringList &removed,
+                     const QStringList &modified, const QStringList &mimeTypes);
+
+protected:
+    void connectNotify(const QMetaMethod &signal) override;
 };
 
 #endif // XDGMIMEAPPS_H
@@ -21,8 +21,11 @@
 #ifndef XDGMIMEAPPS_P_H
 #define XDGMIMEAPPS_P_H
 
+#include "xdgmimeapps.h"
+
 #include <private/qobject_p.h>
-#include <QMutex>
+
+#include <memory>
 
 class XdgMimeApps;
 class XdgMimeAppsBackendInterface;
@@ -34,11 +37,11 @@ public:
     XdgMimeAppsPrivate();
     ~XdgMimeAppsPrivate();
 
-    void init();
+    void init(XdgMimeApps::Backend backend);
     static XdgMimeAppsPrivate *instance();
 
-    QMutex mutex;
-    XdgMimeAppsBackendInterface *mBackend;
+    // Shared with the other XdgMimeApps using the same backend
+    std::shared_ptr<XdgMimeAppsBackendInterface> mBackend;
 };
 
 #endif // XDGMIMEAPPS_P_H
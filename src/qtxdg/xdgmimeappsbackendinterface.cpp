@@ -20,9 +20,69 @@
 
 #include "xdgmimeappsbackendinterface.h"
 
+using namespace Qt::Literals::StringLiterals;
+
 XdgMimeAppsBackendInterface::XdgMimeAppsBackendInterface(QObject *parent)
     : QObject(parent)
 {
 }
 
 XdgMimeAppsBackendInterface::~XdgMimeAppsBackendInterface() = default;
+
+void XdgMimeAppsBackendInterface::indexCategories(const QString &id, const XdgDesktopFile &app,
+                                                  QHash<QString, QStringList> *categories)
+{
+    const QString value = app.value("Categories"_L1).toString();
+    for (const QStringView category : QStringView(value).split(u';', Qt::SkipEmptyParts)) {
+        const QString key = category.toString().toUpper();
+        const auto add = [&id, categories] (const QString &key) {
+            QStringList &ids = (*categories)[key];
+            // The apps are indexed one by one, a repeated category is last
+            if (ids.isEmpty() || ids.constLast() != id)
+                ids.append(id);
+        };
+        add(key);
+        if (key.startsWith("X-"_L1) && key.size() > 2)
+            add(key.mid(2));
+    }
+}
+
+void XdgMimeAppsBackendInterface::diffApps(const AppStamps &before, const AppStamps &after,
+                                           QStringList *added, QStringList *removed, QStringList *modified)
+{
+    for (auto it = after.cbegin(); it != after.cend(); ++it) {
+        const auto old = before.constFind(it.key());
+        if (old == before.cend())
+            added->append(it.key());
+        else if (!(*old == *it))
+            modified->append(it.key());
+    }
+    for (auto it = before.cbegin(); it != before.cend(); ++it) {
+        if (!after.contains(it.key()))
+            removed->append(it.key());
+    }
+}
+
+void XdgMimeAppsBackendInterface::addMimeTypes(const XdgDesktopFile &app, QSet<QString> *mimeTypes)
+{
+    if (!app.isValid())
+        return;
+    const QStringList types = app.mimeTypes();
+    for (const QString &type : types)
+        mimeTypes->insert(type);
+}
+
+void XdgMimeAppsBackendInterface::reportChanges(QStringList added, QStringList removed, QStringList modified,
+                                                const QSet<QString> &mimeTypes)
+{
+    Q_EMIT changed();
+    if (added.isEmpty() && removed.isEmpty() && modified.isEmpty() && mimeTypes.isEmpty())
+        return;
+
+    QStringList types(mimeTypes.cbegin(), mimeTypes.cend());
+    added.sort();
+    removed.sort();
+    modified.sort();
+    types.sort();
+    Q_EMIT appsChanged(added, removed, modified, types);
+}
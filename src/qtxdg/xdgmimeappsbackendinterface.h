@@ -21,9 +21,13 @@
 #ifndef XDGMIMEAPPSBACKENDINTERFACE_H
 #define XDGMIMEAPPSBACKENDINTERFACE_H
 
-#include <QObject>
+#include "xdgdesktopfile.h"
 
-class XdgDesktopFile;
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
 
 class QString;
 
@@ -35,17 +39,55 @@ public:
     virtual ~XdgMimeAppsBackendInterface();
 
     virtual bool addAssociation(const QString &mimeType, const XdgDesktopFile &app) = 0;
-    virtual QList<XdgDesktopFile *> allApps() = 0;
-    virtual QList<XdgDesktopFile *> apps(const QString &mimeType) = 0;
-    virtual XdgDesktopFile *defaultApp(const QString &mimeType) = 0;
-    virtual QList<XdgDesktopFile *> fallbackApps(const QString &mimeType) = 0;
-    virtual QList<XdgDesktopFile *> recommendedApps(const QString &mimeType) = 0;
+    // The entries are shared with the caches of the backends, an invalid
+    // defaultApp() means there's none
+    virtual XdgDesktopFileList allApps() = 0;
+    virtual XdgDesktopFileList apps(const QString &mimeType) = 0;
+    virtual XdgDesktopFile defaultApp(const QString &mimeType) = 0;
+    virtual XdgDesktopFileList categoryApps(const QString &category) = 0;
+    virtual XdgDesktopFileList fallbackApps(const QString &mimeType) = 0;
+    virtual XdgDesktopFileList recommendedApps(const QString &mimeType) = 0;
     virtual bool reset(const QString &mimeType) = 0;
     virtual bool removeAssociation(const QString &mimeType, const XdgDesktopFile &app) = 0;
     virtual bool setDefaultApp(const QString &mimeType, const XdgDesktopFile &app) = 0;
+    // Makes the backend report what changed with appsChanged(). It has to
+    // keep a snapshot of the installed apps for that.
+    virtual void trackChanges() = 0;
 
 Q_SIGNALS:
     void changed();
+    // Emitted after changed() while tracking, unless nothing it tells about
+    // changed. The lists are sorted.
+    void appsChanged(const QStringList &added, const QStringList &removed,
+                     const QStringList &modified, const QStringList &mimeTypes);
+
+protected:
+    // The file of an installed app, a copy masking it or an update of the
+    // file makes it modified
+    struct AppStamp
+    {
+        QString fileName;
+        QDateTime modified;
+
+        bool operator==(const AppStamp &other) const
+        {
+            return fileName == other.fileName && modified == other.modified;
+        }
+    };
+    using AppStamps = QHash<QString, AppStamp>;
+
+    static void diffApps(const AppStamps &before, const AppStamps &after,
+                         QStringList *added, QStringList *removed, QStringList *modified);
+    // Adds the types of app, if it's valid
+    static void addMimeTypes(const XdgDesktopFile &app, QSet<QString> *mimeTypes);
+    // Emits changed(), then appsChanged() if there's something to tell
+    void reportChanges(QStringList added, QStringList removed, QStringList modified,
+                       const QSet<QString> &mimeTypes);
+
+    // Adds the id of app to the lists of its categories. The keys are upper
+    // case and the X- categories are listed under their plain name too.
+    static void indexCategories(const QString &id, const XdgDesktopFile &app,
+                                QHash<QString, QStringList> *categories);
 };
 
 #endif // XDGMIMEAPPSBACKENDINTERFACE_H
@@ -31,25 +31,12 @@
 #include <QDebug>
 #include <QLoggingCategory>
 #include <QMimeDatabase>
+#include <QFile>
+#include <QFileInfo>
+#include <QMutexLocker>
 
-static QList<XdgDesktopFile *> GAppInfoGListToXdgDesktopQList(GList *list)
-{
-    QList<XdgDesktopFile *> dl;
-    for (GList *l = list; l != nullptr; l = l->next) {
-        if (l->data) {
-            const QString file = QString::fromUtf8(g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(l->data)));
-            if (!file.isEmpty()) {
-                XdgDesktopFile *df = new XdgDesktopFile;
-                if (df->load(file) && df->isValid()) {
-                    dl.append(df);
-                } else {
-                    delete df;
-                }
-            }
-        }
-    }
-    return dl;
-}
+#include <algorithm>
+#include <utility>
 
 static GDesktopAppInfo *XdgDesktopFileToGDesktopAppinfo(const XdgDesktopFile &app)
 {
@@ -84,13 +71,363 @@ XdgMimeAppsGLibBackend::XdgMimeAppsGLibBackend(QObject *parent)
 
 XdgMimeAppsGLibBackend::~XdgMimeAppsGLibBackend()
 {
-    g_object_unref(mWatcher);
+    if (mWatcher != nullptr) {
+        // The monitor is a singleton, it outlives this backend
+        g_signal_handlers_disconnect_by_data(mWatcher, this);
+        g_object_unref(mWatcher);
+    }
 }
 
 void XdgMimeAppsGLibBackend::_changed(GAppInfoMonitor *monitor, XdgMimeAppsGLibBackend *_this)
 {
     Q_UNUSED(monitor);
-    Q_EMIT _this->changed();
+    _this->update(false);
+}
+
+// mMutex must be held
+void XdgMimeAppsGLibBackend::clear()
+{
+    for (QHash<QString, QStringList> &query : mQueries)
+        query.clear();
+    mAllApps.reset();
+    mCategories.reset();
+    mEntries.clear();
+}
+
+// The list files GIO reads the associations from, like the native backend
+static QStringList listFiles()
+{
+    const QStringList desktops = QString::fromLocal8Bit(qgetenv("XDG_CURRENT_DESKTOP")).toLower()
+                                     .split(u':', Qt::SkipEmptyParts);
+    QStringList configDirs = XdgDirs::configDirs();
+    configDirs.prepend(XdgDirs::configHome(false));
+    QStringList appDirs = XdgDirs::dataDirs(QLatin1String("/applications"));
+    appDirs.prepend(XdgDirs::dataHome(false) + QLatin1String("/applications"));
+
+    QStringList files;
+    for (const QString &dir : configDirs + appDirs) {
+        for (const QString &desktop : desktops)
+            files.append(dir + u'/' + desktop + QLatin1String("-mimeapps.list"));
+        files.append(dir + QLatin1String("/mimeapps.list"));
+    }
+    for (const QString &dir : std::as_const(appDirs)) {
+        files.append(dir + QLatin1String("/defaults.list"));
+        files.append(dir + QLatin1String("/mimeinfo.cache"));
+    }
+    files.removeDuplicates();
+    return files;
+}
+
+// The values of a list file, keyed by their group and type
+static QHash<QString, QString> readListValues(const QString &fileName)
+{
+    QHash<QString, QString> values;
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return values;
+
+    const QString text = QString::fromUtf8(file.readAll());
+    QStringView group;
+    for (QStringView line : QStringView(text).tokenize(u'\n', Qt::SkipEmptyParts)) {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith(u'#'))
+            continue;
+        if (line.startsWith(u'[') && line.endsWith(u']')) {
+            group = line.sliced(1, line.size() - 2);
+            continue;
+        }
+        const qsizetype eq = line.indexOf(u'=');
+        if (eq <= 0)
+            continue;
+        QString key = group.toString();
+        key += u'\n';
+        key += line.first(eq).trimmed();
+        values.insert(key, line.sliced(eq + 1).trimmed().toString());
+    }
+    return values;
+}
+
+/*
+ * Reads the list files that changed since the last time and adds the types
+ * whose associations differ. Returns false if none changed. mMutex must be
+ * held.
+ */
+bool XdgMimeAppsGLibBackend::readLists(QSet<QString> *mimeTypes)
+{
+    bool changed = false;
+    const auto addType = [mimeTypes] (const QString &key) {
+        mimeTypes->insert(key.sliced(key.indexOf(u'\n') + 1));
+    };
+    for (const QString &fileName : listFiles()) {
+        const QDateTime modified = QFileInfo(fileName).lastModified();
+        const auto it = mLists.constFind(fileName);
+        if (it != mLists.constEnd() && it->modified == modified)
+            continue;
+
+        const QHash<QString, QString> before = it != mLists.constEnd() ? it->values : QHash<QString, QString>();
+        const QHash<QString, QString> after = modified.isValid() ? readListValues(fileName) : QHash<QString, QString>();
+        for (auto value = before.cbegin(); value != before.cend(); ++value) {
+            if (after.value(value.key()) != value.value())
+                addType(value.key());
+        }
+        for (auto value = after.cbegin(); value != after.cend(); ++value) {
+            if (!before.contains(value.key()))
+                addType(value.key());
+        }
+        mLists.insert(fileName, {modified, after});
+        changed = true;
+    }
+    return changed;
+}
+
+// If GIO's answers about type may depend on the associations of
+// changedTypes (or of their parents), or on the apps of changedApps
+static bool isAffected(const QString &type, const QStringList &ids,
+                       const QSet<QString> &changedTypes, const QStringList &changedApps)
+{
+    if (changedTypes.contains(type))
+        return true;
+    for (const QString &id : ids) {
+        if (changedApps.contains(id))
+            return true;
+    }
+    const QMimeType mime = QMimeDatabase().mimeTypeForName(type);
+    QStringList names = mime.allAncestors() + mime.aliases();
+    names.append(mime.name());
+    return std::any_of(names.cbegin(), names.cend(), [&changedTypes] (const QString &name) {
+        return changedTypes.contains(name);
+    });
+}
+
+/*
+ * Forgets the answers of GIO that may have changed and reports the change.
+ * The list files are read again to tell which types they changed.
+ *
+ * GIO itself only reads them again once its monitor tells. After a write
+ * made here, the queries about the changed types are just dropped: asked
+ * right away, GIO would answer as before. The monitor's event is when its
+ * answers become current. While tracking, the installed apps are compared
+ * with the snapshot then, and only the queries about the types of the
+ * changed apps and lists (or their subtypes) are asked again; the ones with
+ * other answers changed as well.
+ */
+void XdgMimeAppsGLibBackend::update(bool ownWrite)
+{
+    QStringList added;
+    QStringList removed;
+    QStringList modified;
+    QSet<QString> mimeTypes;
+    QMutexLocker locker(&mMutex);
+    readLists(&mimeTypes);
+
+    if (!mTrackChanges) {
+        clear();
+    } else if (ownWrite) {
+        mPendingTypes.unite(mimeTypes);
+        for (QHash<QString, QStringList> &queries : mQueries) {
+            queries.removeIf([&mimeTypes] (const QHash<QString, QStringList>::iterator it) {
+                return isAffected(it.key(), it.value(), mimeTypes, QStringList());
+            });
+        }
+    } else {
+        // GIO is asked and the apps are parsed without the lock, the other
+        // threads are served the previous answers meanwhile
+        const AppStamps before = mAppStamps;
+        locker.unlock();
+        AppStamps stamps = appStamps();
+        diffApps(before, stamps, &added, &removed, &modified);
+        QHash<QString, XdgDesktopFile> parsed;
+        for (const QString &id : added + modified) {
+            XdgDesktopFile df;
+            // Broken files are remembered too, they're skipped
+            if (!df.load(stamps.value(id).fileName))
+                df = XdgDesktopFile();
+            parsed.insert(id, df);
+        }
+        locker.relock();
+
+        mAppStamps = std::move(stamps);
+        // Including the ones written here, GIO has read them now
+        mimeTypes.unite(std::exchange(mPendingTypes, QSet<QString>()));
+        readLists(&mimeTypes);
+        for (const QString &id : std::as_const(removed))
+            addMimeTypes(mEntries.take(id), &mimeTypes);
+        for (const QString &id : std::as_const(modified))
+            addMimeTypes(mEntries.take(id), &mimeTypes);
+        for (auto it = parsed.cbegin(); it != parsed.cend(); ++it) {
+            addMimeTypes(it.value(), &mimeTypes);
+            mEntries.insert(it.key(), it.value());
+        }
+        if (!added.isEmpty() || !removed.isEmpty() || !modified.isEmpty()) {
+            mAllApps.reset();
+            mCategories.reset();
+        }
+
+        // The queries GIO may answer differently now, with what it answered
+        struct Asked
+        {
+            Query query;
+            QString mimeType;
+            QStringList ids;
+            AppFiles answer;
+        };
+        QList<Asked> asked;
+        const QSet<QString> changedTypes = mimeTypes;
+        const QStringList changedApps = removed + modified;
+        for (int query = 0; query < QueryCount; ++query) {
+            mQueries[query].removeIf([&] (const QHash<QString, QStringList>::iterator it) {
+                if (!isAffected(it.key(), it.value(), changedTypes, changedApps))
+                    return false;
+                asked.append({Query(query), it.key(), it.value(), AppFiles()});
+                return true;
+            });
+        }
+
+        locker.unlock();
+        for (Asked &a : asked)
+            a.answer = ask(a.query, a.mimeType);
+        locker.relock();
+
+        for (const Asked &a : std::as_const(asked)) {
+            const QStringList ids = appInfoIds(a.answer);
+            // Unless a query made meanwhile got it already
+            if (!mQueries[a.query].contains(a.mimeType))
+                mQueries[a.query].insert(a.mimeType, ids);
+            if (ids != a.ids)
+                mimeTypes.insert(a.mimeType);
+        }
+        // Neither the apps nor the lists changed, nor GIO's answers
+        if (added.isEmpty() && removed.isEmpty() && modified.isEmpty() && mimeTypes.isEmpty())
+            return;
+    }
+    locker.unlock();
+    reportChanges(added, removed, modified, mimeTypes);
+}
+
+void XdgMimeAppsGLibBackend::trackChanges()
+{
+    QMutexLocker locker(&mMutex);
+    if (mTrackChanges)
+        return;
+    mTrackChanges = true;
+    mAppStamps = appStamps();
+    QSet<QString> mimeTypes;
+    readLists(&mimeTypes);
+}
+
+// The desktop id and the file of the app, false if it has no file
+static bool appInfoFile(gpointer data, QString *id, QString *fileName)
+{
+    if (data == nullptr || !G_IS_DESKTOP_APP_INFO(data))
+        return false;
+    const char *file = g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(data));
+    if (file == nullptr)
+        return false;
+
+    *fileName = QString::fromUtf8(file);
+    // Apps loaded from files outside of the applications dirs have no id
+    const char *desktopId = g_app_info_get_id(G_APP_INFO(data));
+    *id = desktopId != nullptr ? QString::fromUtf8(desktopId) : *fileName;
+    return true;
+}
+
+// The desktop ids and the files of the apps in list, which is freed
+XdgMimeAppsGLibBackend::AppFiles XdgMimeAppsGLibBackend::appFiles(GList *list)
+{
+    AppFiles files;
+    QString id;
+    QString fileName;
+    for (GList *l = list; l != nullptr; l = l->next) {
+        if (appInfoFile(l->data, &id, &fileName))
+            files.append({id, fileName});
+    }
+    g_list_free_full(list, g_object_unref);
+    return files;
+}
+
+// The files of all the apps, without parsing them
+XdgMimeAppsBackendInterface::AppStamps XdgMimeAppsGLibBackend::appStamps()
+{
+    AppStamps stamps;
+    const AppFiles files = appFiles(g_app_info_get_all());
+    for (const auto &[id, fileName] : files)
+        stamps.insert(id, {fileName, QFileInfo(fileName).lastModified()});
+    return stamps;
+}
+
+// Returns the desktop ids of the apps in files, parsing the ones not seen
+// yet. mMutex must be held.
+QStringList XdgMimeAppsGLibBackend::appInfoIds(const AppFiles &files)
+{
+    QStringList ids;
+    ids.reserve(files.size());
+    for (const auto &[id, fileName] : files) {
+        if (!mEntries.contains(id)) {
+            XdgDesktopFile df;
+            // Broken files are remembered too, they're skipped
+            if (!df.load(fileName))
+                df = XdgDesktopFile();
+            mEntries.insert(id, df);
+        }
+        ids.append(id);
+    }
+    return ids;
+}
+
+// mMutex must be held
+XdgDesktopFileList XdgMimeAppsGLibBackend::desktopFiles(const QStringList &ids) const
+{
+    XdgDesktopFileList dl;
+    dl.reserve(ids.size());
+    for (const QString &id : ids) {
+        const auto it = mEntries.constFind(id);
+        // The copies share the parsed data
+        if (it != mEntries.constEnd() && it->isValid())
+            dl.append(*it);
+    }
+    return dl;
+}
+
+XdgDesktopFileList XdgMimeAppsGLibBackend::cachedApps(Query query, const QString &mimeType)
+{
+    QMutexLocker locker(&mMutex);
+    return desktopFiles(queryIds(query, mimeType));
+}
+
+// What GIO answers to the query
+XdgMimeAppsGLibBackend::AppFiles XdgMimeAppsGLibBackend::ask(Query query, const QString &mimeType)
+{
+    const QByteArray type = mimeType.toUtf8();
+    GList *list = nullptr;
+    switch (query) {
+        case AllForType:
+        list = g_app_info_get_all_for_type(type.constData());
+        break;
+    case Recommended:
+        list = g_app_info_get_recommended_for_type(type.constData());
+        break;
+    case Fallback:
+        // g_app_info_get_fallback_for_type() doesn't returns the ones in the
+        // recommended list
+        list = g_app_info_get_fallback_for_type(type.constData());
+        break;
+    case Default:
+        if (GAppInfo *appinfo = g_app_info_get_default_for_type(type.constData(), false))
+            list = g_list_prepend(nullptr, appinfo);
+        break;
+    case QueryCount:
+        break;
+    }
+    return appFiles(list);
+}
+
+// What GIO answers to the query, remembered. mMutex must be held.
+const QStringList &XdgMimeAppsGLibBackend::queryIds(Query query, const QString &mimeType)
+{
+    auto it = mQueries[query].constFind(mimeType);
+    if (it == mQueries[query].constEnd())
+        it = mQueries[query].insert(mimeType, appInfoIds(ask(query, mimeType)));
+    return *it;
 }
 
 bool XdgMimeAppsGLibBackend::addAssociation(const QString &mimeType, const XdgDesktopFile &app)
@@ -110,41 +447,53 @@ bool XdgMimeAppsGLibBackend::addAssociation(const QString &mimeType, const XdgDe
         return false;
     }
     g_object_unref(gApp);
+    // Don't wait for the monitor, the next queries must see the change
+    update(true);
     return true;
 }
 
-QList<XdgDesktopFile *> XdgMimeAppsGLibBackend::allApps()
+// mMutex must be held
+const QStringList &XdgMimeAppsGLibBackend::allAppIds()
 {
-    GList *list = g_app_info_get_all();
-    QList<XdgDesktopFile *> dl = GAppInfoGListToXdgDesktopQList(list);
-    g_list_free_full(list, g_object_unref);
-    return dl;
+    if (!mAllApps)
+        mAllApps = appInfoIds(appFiles(g_app_info_get_all()));
+    return *mAllApps;
 }
 
-QList<XdgDesktopFile *> XdgMimeAppsGLibBackend::apps(const QString &mimeType)
+XdgDesktopFileList XdgMimeAppsGLibBackend::allApps()
 {
-    GList *list = g_app_info_get_all_for_type(mimeType.toUtf8().constData());
-    QList<XdgDesktopFile *> dl = GAppInfoGListToXdgDesktopQList(list);
-    g_list_free_full(list, g_object_unref);
-    return dl;
+    QMutexLocker locker(&mMutex);
+    return desktopFiles(allAppIds());
 }
 
-QList<XdgDesktopFile *> XdgMimeAppsGLibBackend::fallbackApps(const QString &mimeType)
+XdgDesktopFileList XdgMimeAppsGLibBackend::categoryApps(const QString &category)
 {
-    // g_app_info_get_fallback_for_type() doesn't returns the ones in the
-    // recommended list
-    GList *list = g_app_info_get_fallback_for_type(mimeType.toUtf8().constData());
-    QList<XdgDesktopFile *> dl = GAppInfoGListToXdgDesktopQList(list);
-    g_list_free_full(list, g_object_unref);
-    return dl;
+    QMutexLocker locker(&mMutex);
+    if (!mCategories) {
+        // All the apps are parsed already
+        mCategories.emplace();
+        for (const QString &id : allAppIds()) {
+            const XdgDesktopFile df = mEntries.value(id);
+            if (df.isValid())
+                indexCategories(id, df, &*mCategories);
+        }
+    }
+    return desktopFiles(mCategories->value(category.toUpper()));
 }
 
-QList<XdgDesktopFile *> XdgMimeAppsGLibBackend::recommendedApps(const QString &mimeType)
+XdgDesktopFileList XdgMimeAppsGLibBackend::apps(const QString &mimeType)
 {
-    GList *list = g_app_info_get_recommended_for_type(mimeType.toUtf8().constData());
-    QList<XdgDesktopFile *> dl = GAppInfoGListToXdgDesktopQList(list);
-    g_list_free_full(list, g_object_unref);
-    return dl;
+    return cachedApps(AllForType, mimeType);
+}
+
+XdgDesktopFileList XdgMimeAppsGLibBackend::fallbackApps(const QString &mimeType)
+{
+    return cachedApps(Fallback, mimeType);
+}
+
+XdgDesktopFileList XdgMimeAppsGLibBackend::recommendedApps(const QString &mimeType)
+{
+    return cachedApps(Recommended, mimeType);
 }
 
 bool XdgMimeAppsGLibBackend::removeAssociation(const QString &mimeType, const XdgDesktopFile &app)
@@ -164,38 +513,21 @@ bool XdgMimeAppsGLibBackend::removeAssociation(const QString &mimeType, const Xd
         return false;
     }
     g_object_unref(gApp);
+    update(true);
     return true;
 }
 
 bool XdgMimeAppsGLibBackend::reset(const QString &mimeType)
 {
     g_app_info_reset_type_associations(mimeType.toUtf8().constData());
+    update(true);
     return true;
 }
 
-XdgDesktopFile *XdgMimeAppsGLibBackend::defaultApp(const QString &mimeType)
+XdgDesktopFile XdgMimeAppsGLibBackend::defaultApp(const QString &mimeType)
 {
-    GAppInfo *appinfo = g_app_info_get_default_for_type(mimeType.toUtf8().constData(), false);
-    if (appinfo == nullptr || !G_IS_DESKTOP_APP_INFO(appinfo)) {
-        return nullptr;
-    }
-
-    const char *file = g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(appinfo));
-
-    if (file == nullptr) {
-        g_object_unref(appinfo);
-        return nullptr;
-    }
-
-    const QString s = QString::fromUtf8(file);
-    g_object_unref(appinfo);
-
-    XdgDesktopFile *f = new XdgDesktopFile;
-    if (f->load(s) && f->isValid())
-        return f;
-
-    delete f;
-    return nullptr;
+    const XdgDesktopFileList dl = cachedApps(Default, mimeType);
+    return dl.isEmpty() ? XdgDesktopFile() : dl.first();
 }
 
 bool XdgMimeAppsGLibBackend::setDefaultApp(const QString &mimeType, const XdgDesktopFile &app)
@@ -221,6 +553,7 @@ bool XdgMimeAppsGLibBackend::setDefaultApp(const QString &mimeType, const XdgDes
                                               nullptr);
 
     const char *desktop_id = g_app_info_get_id(G_APP_INFO(gApp));
+    QMutexLocker writeLocker(&mWriteMutex);
     GKeyFile *kf = g_key_file_new();
     g_key_file_load_from_file(kf, mimeappsListPath, G_KEY_FILE_NONE, nullptr);
     g_key_file_set_string(kf, "Default Applications", mimeType.toUtf8().constData(), desktop_id);
@@ -236,6 +569,8 @@ bool XdgMimeAppsGLibBackend::setDefaultApp(const QString &mimeType, const XdgDes
     }
     g_key_file_free(kf);
     g_free(mimeappsListPath);
+    writeLocker.unlock();
+    update(true);
 
     qCDebug(QtXdgMimeAppsGLib, "Set '%s' as the default for '%s'",
             g_desktop_app_info_get_filename(gApp), qPrintable(mimeType));
@@ -22,12 +22,21 @@
 #define XDGMIMEAPPSGLIBBACKEND_H
 
 #include "xdgmimeappsbackendinterface.h"
+#include "xdgdesktopfile.h"
 
-class XdgDesktopFile;
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+#include <optional>
+#include <utility>
 
 class QString;
 
 typedef struct _GAppInfoMonitor GAppInfoMonitor;
+typedef struct _GList GList;
 
 class Q_DECL_HIDDEN XdgMimeAppsGLibBackend : public XdgMimeAppsBackendInterface {
 public:
@@ -35,18 +44,70 @@ public:
     ~XdgMimeAppsGLibBackend() override;
 
     bool addAssociation(const QString &mimeType, const XdgDesktopFile &app) override;
-    QList<XdgDesktopFile *> allApps() override;
-    QList<XdgDesktopFile *> apps(const QString &mimeType) override;
-    XdgDesktopFile *defaultApp(const QString &mimeType) override;
-    QList<XdgDesktopFile *> fallbackApps(const QString &mimeType) override;
-    QList<XdgDesktopFile *> recommendedApps(const QString &mimeType) override;
+    XdgDesktopFileList allApps() override;
+    XdgDesktopFileList apps(const QString &mimeType) override;
+    XdgDesktopFile defaultApp(const QString &mimeType) override;
+    XdgDesktopFileList categoryApps(const QString &category) override;
+    XdgDesktopFileList fallbackApps(const QString &mimeType) override;
+    XdgDesktopFileList recommendedApps(const QString &mimeType) override;
     bool removeAssociation(const QString &mimeType, const XdgDesktopFile &app) override;
     bool reset(const QString &mimeType) override;
     bool setDefaultApp(const QString &mimeType, const XdgDesktopFile &app) override;
+    void trackChanges() override;
 
 private:
+    enum Query {
+        AllForType,
+        Recommended,
+        Fallback,
+        Default,
+        QueryCount
+    };
+
+    // The desktop id and the file of each app
+    using AppFiles = QList<std::pair<QString, QString>>;
+
+    XdgDesktopFileList cachedApps(Query query, const QString &mimeType);
+    const QStringList &queryIds(Query query, const QString &mimeType);
+    static AppFiles ask(Query query, const QString &mimeType);
+    static AppFiles appFiles(GList *list);
+    QStringList appInfoIds(const AppFiles &files);
+    const QStringList &allAppIds();
+    XdgDesktopFileList desktopFiles(const QStringList &ids) const;
+    static AppStamps appStamps();
+    bool readLists(QSet<QString> *mimeTypes);
+    void clear();
+    void update(bool ownWrite);
+
     GAppInfoMonitor *mWatcher;
     static void _changed(GAppInfoMonitor *monitor, XdgMimeAppsGLibBackend *_this);
+
+    // What GIO answered, until the monitor reports a change: the desktop ids
+    // of each query per MIME type, and the parsed desktop file of each id.
+    // Queries are then served from memory, without loading any file.
+    QMutex mMutex;
+    // Serializes the edits of the desktop specific mimeapps.list
+    QMutex mWriteMutex;
+    QHash<QString, QStringList> mQueries[QueryCount];
+    std::optional<QStringList> mAllApps;
+    // The ids of all the apps per category, see indexCategories()
+    std::optional<QHash<QString, QStringList>> mCategories;
+    QHash<QString, XdgDesktopFile> mEntries;
+    // The installed apps when last compared, while tracking the changes
+    bool mTrackChanges = false;
+    AppStamps mAppStamps;
+
+    // The associations of a list file GIO reads, by group and type
+    struct ListFile
+    {
+        QDateTime modified;
+        QHash<QString, QString> values;
+    };
+    // The list files when last read, to tell which types they changed
+    QHash<QString, ListFile> mLists;
+    // The types whose associations were written here, GIO answers about
+    // them as before until its monitor tells
+    QSet<QString> mPendingTypes;
 };
 
 #endif // XDGMIMEAPPSGLIBBACKEND_H
@@ -0,0 +1,811 @@
+/*
+ * libqtxdg - An Qt implementation of freedesktop.org xdg specs
+ * Copyright (C) 2026  LXQt team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "xdgmimeappsnativebackend.h"
+
+#include "qtxdglogging.h"
+#include "xdgdesktopfile.h"
+#include "xdgdirs.h"
+
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QLoggingCategory>
+#include <QMimeDatabase>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QTimer>
+
+#include <algorithm>
+#include <optional>
+#include <utility>
+
+using namespace Qt::Literals::StringLiterals;
+
+static constexpr QLatin1StringView defaultGroup("Default Applications");
+static constexpr QLatin1StringView addedGroup("Added Associations");
+static constexpr QLatin1StringView removedGroup("Removed Associations");
+static constexpr QLatin1StringView mimeCacheGroup("MIME Cache");
+
+namespace {
+// The associations read from the files of one directory
+struct MimeAssociations
+{
+    QHash<QString, QStringList> defaults;
+    QHash<QString, QStringList> additions;
+    QHash<QString, QStringList> removals;
+};
+
+enum class ListKind {
+    MimeApps,       // mimeapps.list and the desktop specific ones
+    Defaults,       // defaults.list, only has defaults
+    MimeInfoCache   // mimeinfo.cache, the types of the installed files
+};
+}
+
+struct XdgMimeAppsIndex
+{
+    struct App
+    {
+        QString fileName;
+        // Index of the first directory that has it, in dirs
+        qsizetype dir;
+        // Only known while tracking the changes
+        QDateTime modified;
+    };
+
+    // An app installed in a more important directory than the associations
+    // talking about it ignores them
+    bool isMasked(const QString &id, qsizetype dir) const
+    {
+        const auto it = apps.constFind(id);
+        return it != apps.constEnd() && it->dir < dir;
+    }
+
+    // The config directories, then the applications directories, from the
+    // most important one
+    QList<MimeAssociations> dirs;
+    QHash<QString, App> apps;
+    // The installed desktop ids, in the order of the directories
+    QStringList appIds;
+    // The ids of the installed apps per category, see indexCategories().
+    // Built on the first category query, it parses all the apps.
+    std::optional<QHash<QString, QStringList>> categories;
+    // The applications directories and their subdirectories
+    QStringList appDirs;
+    // The list files, read or not. The config directories have many other
+    // files, their changes are checked against these.
+    QHash<QString, QDateTime> listStamps;
+};
+
+// The desktops of XDG_CURRENT_DESKTOP, lowercased
+static QStringList currentDesktops()
+{
+    return QString::fromLocal8Bit(qgetenv("XDG_CURRENT_DESKTOP")).toLower().split(u':', Qt::SkipEmptyParts);
+}
+
+static QStringList splitIds(QStringView value)
+{
+    QStringList ids;
+    for (QStringView id : value.tokenize(u';', Qt::SkipEmptyParts)) {
+        id = id.trimmed();
+        if (!id.isEmpty())
+            ids.append(id.toString());
+    }
+    return ids;
+}
+
+// Appends the ids that are neither in list nor in exclude yet
+static void expand(QStringList &list, const QStringList &ids, const QStringList &exclude = QStringList())
+{
+    for (const QString &id : ids) {
+        if (!list.contains(id) && !exclude.contains(id))
+            list.append(id);
+    }
+}
+
+// Reads one of the list files of a directory into associations. The files
+// read first take precedence.
+static void readList(const QString &fileName, ListKind kind, MimeAssociations *associations,
+                     QHash<QString, QDateTime> *stamps)
+{
+    const QFileInfo info(fileName);
+    stamps->insert(fileName, info.lastModified());
+
+    QFile file(fileName);
+    if (!info.isFile() || !file.open(QIODevice::ReadOnly))
+        return;
+
+    const QString text = QString::fromUtf8(file.readAll());
+    QStringView group;
+    for (QStringView line : QStringView(text).tokenize(u'\n', Qt::SkipEmptyParts)) {
+        line = line.trimmed();
+        if (line.isEmpty() || line.startsWith(u'#'))
+            continue;
+        if (line.startsWith(u'[') && line.endsWith(u']')) {
+            group = line.sliced(1, line.size() - 2);
+            continue;
+        }
+
+        const qsizetype eq = line.indexOf(u'=');
+        if (eq <= 0)
+            continue;
+        const QString mimeType = line.first(eq).trimmed().toString();
+        const QStringList ids = splitIds(line.sliced(eq + 1));
+
+        switch (kind) {
+        case ListKind::MimeApps:
+            if (group == addedGroup)
+                expand(associations->additions[mimeType], ids, associations->removals.value(mimeType));
+            else if (group == removedGroup)
+                expand(associations->removals[mimeType], ids, associations->additions.value(mimeType));
+            else if (group == defaultGroup)
+                expand(associations->defaults[mimeType], ids);
+            break;
+        case ListKind::Defaults:
+            if (group == defaultGroup)
+                expand(associations->defaults[mimeType], ids);
+            break;
+        case ListKind::MimeInfoCache:
+            if (group == mimeCacheGroup)
+                expand(associations->additions[mimeType], ids, associations->removals.value(mimeType));
+            break;
+        }
+    }
+}
+
+// Reads all the list files of a directory
+static MimeAssociations readLists(const QString &dirName, bool isConfig, const QStringList &desktops,
+                                  QHash<QString, QDateTime> *stamps)
+{
+    MimeAssociations associations;
+    for (const QString &desktop : desktops)
+        readList(dirName + u'/' + desktop + "-mimeapps.list"_L1, ListKind::MimeApps, &associations, stamps);
+    readList(dirName + "/mimeapps.list"_L1, ListKind::MimeApps, &associations, stamps);
+    if (!isConfig) {
+        readList(dirName + "/defaults.list"_L1, ListKind::Defaults, &associations, stamps);
+        readList(dirName + "/mimeinfo.cache"_L1, ListKind::MimeInfoCache, &associations, stamps);
+    }
+    return associations;
+}
+
+// The unaliased type, followed by its parents if includeFallback, breadth
+// first
+static QStringList mimeTypeChain(const QString &mimeType, bool includeFallback)
+{
+    const QMimeDatabase db;
+    const QMimeType type = db.mimeTypeForName(mimeType);
+    QStringList types(type.isValid() ? type.name() : mimeType);
+    if (includeFallback) {
+        for (qsizetype i = 0; i < types.size(); ++i) {
+            const QStringList parents = db.mimeTypeForName(types.at(i)).parentMimeTypes();
+            for (const QString &parent : parents) {
+                if (!types.contains(parent))
+                    types.append(parent);
+            }
+        }
+    }
+    return types;
+}
+
+// The names the files may use for a type
+static QStringList mimeTypeNames(const QString &mimeType)
+{
+    QStringList names(mimeType);
+    names += QMimeDatabase().mimeTypeForName(mimeType).aliases();
+    return names;
+}
+
+/*
+ * Adds the apps associated with a type to hits, like GIO does: the added
+ * associations and the mimeinfo.cache entries of each directory, unless an
+ * earlier directory removed them.
+ */
+static void mimeLookup(const XdgMimeAppsIndex &index, const QStringList &names,
+                       QStringList *hits, QStringList *blocklist)
+{
+    for (qsizetype d = 0; d < index.dirs.size(); ++d) {
+        const MimeAssociations &dir = index.dirs.at(d);
+        for (const QString &name : names) {
+            const QStringList additions = dir.additions.value(name);
+            for (const QString &id : additions) {
+                if (!index.isMasked(id, d) && !blocklist->contains(id) && !hits->contains(id))
+                    hits->append(id);
+            }
+        }
+        for (const QString &name : names) {
+            const QStringList removals = dir.removals.value(name);
+            for (const QString &id : removals) {
+                if (!index.isMasked(id, d) && !blocklist->contains(id) && !hits->contains(id))
+                    blocklist->append(id);
+            }
+        }
+    }
+}
+
+namespace {
+// A mimeapps.list file being edited. The lines it doesn't change are kept.
+class MimeAppsListFile
+{
+public:
+    explicit MimeAppsListFile(const QString &fileName);
+
+    QStringList value(QStringView group, QStringView key) const;
+    // Removes the key if ids is empty
+    void setValue(QStringView group, const QString &key, const QStringList &ids);
+    bool save() const;
+
+private:
+    struct Group
+    {
+        QString name;
+        QStringList lines;
+    };
+
+    static bool hasKey(QStringView line, QStringView key, QStringView *value = nullptr);
+
+    QString mFileName;
+    QStringList mHeader;
+    QList<Group> mGroups;
+};
+}
+
+MimeAppsListFile::MimeAppsListFile(const QString &fileName)
+    : mFileName(fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    const QString text = QString::fromUtf8(file.readAll());
+    for (QStringView line : QStringView(text).tokenize(u'\n', Qt::SkipEmptyParts)) {
+        const QStringView trimmed = line.trimmed();
+        if (trimmed.isEmpty())
+            continue;
+        if (trimmed.startsWith(u'[') && trimmed.endsWith(u']'))
+            mGroups.append({trimmed.sliced(1, trimmed.size() - 2).toString(), QStringList()});
+        else if (!mGroups.isEmpty())
+            mGroups.last().lines.append(trimmed.toString());
+        else
+            mHeader.append(trimmed.toString());
+    }
+}
+
+bool MimeAppsListFile::hasKey(QStringView line, QStringView key, QStringView *value)
+{
+    const qsizetype eq = line.indexOf(u'=');
+    if (eq <= 0 || line.first(eq).trimmed() != key)
+        return false;
+    if (value)
+        *value = line.sliced(eq + 1);
+    return true;
+}
+
+QStringList MimeAppsListFile::value(QStringView group, QStringView key) const
+{
+    for (const Group &g : mGroups) {
+        if (g.name != group)
+            continue;
+        QStringView value;
+        for (const QString &line : g.lines) {
+            if (hasKey(line, key, &value))
+                return splitIds(value);
+        }
+    }
+    return QStringList();
+}
+
+void MimeAppsListFile::setValue(QStringView group, const QString &key, const QStringList &ids)
+{
+    const QString line = ids.isEmpty() ? QString() : key + u'=' + ids.join(u';') + u';';
+
+    auto g = std::find_if(mGroups.begin(), mGroups.end(), [group] (const Group &g) {
+        return g.name == group;
+    });
+    if (g == mGroups.end()) {
+        if (ids.isEmpty())
+            return;
+        mGroups.append({group.toString(), QStringList()});
+        g = mGroups.end() - 1;
+    }
+
+    for (auto it = g->lines.begin(); it != g->lines.end(); ++it) {
+        if (hasKey(*it, key)) {
+            if (ids.isEmpty())
+                g->lines.erase(it);
+            else
+                *it = line;
+            return;
+        }
+    }
+    if (!ids.isEmpty())
+        g->lines.append(line);
+}
+
+bool MimeAppsListFile::save() const
+{
+    QSaveFile file(mFileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QString text;
+    for (const QString &line : mHeader)
+        text += line + u'\n';
+    for (const Group &g : mGroups) {
+        if (!text.isEmpty())
+            text += u'\n';
+        text += u'[' + g.name + u"]\n"_s;
+        for (const QString &line : g.lines)
+            text += line + u'\n';
+    }
+    file.write(text.toUtf8());
+    return file.commit();
+}
+
+
+XdgMimeAppsNativeBackend::XdgMimeAppsNativeBackend(QObject *parent)
+    : XdgMimeAppsBackendInterface(parent),
+      mWatcher(new QFileSystemWatcher(this)),
+      mChangeTimer(new QTimer(this))
+{
+    mChangeTimer->setSingleShot(true);
+    mChangeTimer->setInterval(200);
+    connect(mChangeTimer, &QTimer::timeout, this, [this] {
+        checkChanges();
+    });
+    connect(mWatcher, &QFileSystemWatcher::directoryChanged, this, [this] (const QString &path) {
+        directoryChanged(path);
+    });
+
+    // Nothing is read before the first query. The subdirectories of the
+    // applications directories are watched once they're known.
+    QStringList dirs = XdgDirs::configDirs();
+    dirs.prepend(XdgDirs::configHome(false));
+    dirs.append(XdgDirs::dataHome(false) + "/applications"_L1);
+    dirs.append(XdgDirs::dataDirs("/applications"_L1));
+    dirs.removeIf([] (const QString &dir) { return !QFileInfo(dir).isDir(); });
+    if (!dirs.isEmpty())
+        mWatcher->addPaths(dirs);
+}
+
+XdgMimeAppsNativeBackend::~XdgMimeAppsNativeBackend() = default;
+
+// mMutex must be held
+void XdgMimeAppsNativeBackend::ensureIndex()
+{
+    if (mIndex)
+        return;
+
+    auto index = std::make_unique<XdgMimeAppsIndex>();
+    const QStringList desktops = currentDesktops();
+
+    // The user's directory comes first, see reloadUserLists()
+    QStringList configDirs = XdgDirs::configDirs();
+    configDirs.prepend(XdgDirs::configHome(false));
+    configDirs.removeDuplicates();
+    for (const QString &dir : std::as_const(configDirs))
+        index->dirs.append(readLists(dir, true, desktops, &index->listStamps));
+
+    QStringList appDirs = XdgDirs::dataDirs("/applications"_L1);
+    appDirs.prepend(XdgDirs::dataHome(false) + "/applications"_L1);
+    appDirs.removeDuplicates();
+    for (const QString &appDir : std::as_const(appDirs)) {
+        index->dirs.append(readLists(appDir, false, desktops, &index->listStamps));
+        const qsizetype dirIndex = index->dirs.size() - 1;
+        const QDir dir(appDir);
+        if (!dir.exists())
+            continue;
+        index->appDirs.append(appDir);
+
+        QStringList ids;
+        QDirIterator it(appDir, QStringList("*.desktop"_L1), QDir::Files,
+                        QDirIterator::Subdirectories | QDirIterator::FollowSymlinks);
+        while (it.hasNext()) {
+            const QString fileName = it.next();
+            const QString path = it.fileInfo().path();
+            if (!index->appDirs.contains(path))
+                index->appDirs.append(path);
+
+            QString id = dir.relativeFilePath(fileName);
+            id.replace(u'/', u'-');
+            if (!index->apps.contains(id)) {
+                index->apps.insert(id, {fileName, dirIndex,
+                                        mTrackChanges ? it.fileInfo().lastModified() : QDateTime()});
+                ids.append(id);
+            }
+        }
+        ids.sort();
+        index->appIds += ids;
+    }
+
+    QMetaObject::invokeMethod(mWatcher, [watcher = mWatcher, dirs = index->appDirs] {
+        const QStringList watched = watcher->directories();
+        QStringList added;
+        for (const QString &dir : dirs) {
+            if (!watched.contains(dir))
+                added.append(dir);
+        }
+        if (!added.isEmpty())
+            watcher->addPaths(added);
+    });
+
+    qCDebug(QtXdgMimeAppsNative, "Indexed %lld desktop files in %lld directories",
+            qint64(index->apps.size()), qint64(appDirs.size()));
+    mIndex = std::move(index);
+}
+
+/*
+ * Returns the parsed desktop file of id. It's invalid if the app isn't
+ * installed or can't run: like GIO, only applications count, with their
+ * TryExec found. Hidden ones were deleted by the user.
+ * mMutex must be held.
+ */
+const XdgDesktopFile &XdgMimeAppsNativeBackend::entry(const QString &id)
+{
+    auto it = mEntries.constFind(id);
+    if (it == mEntries.constEnd()) {
+        XdgDesktopFile df;
+        const auto app = mIndex->apps.constFind(id);
+        if (app == mIndex->apps.constEnd()
+                || !df.load(app->fileName)
+                || df.type() != XdgDesktopFile::ApplicationType
+                || df.value("Hidden"_L1).toBool()
+                || (df.contains("TryExec"_L1) && !df.tryExec())) {
+            df = XdgDesktopFile();
+        }
+        it = mEntries.insert(id, df);
+    }
+    return *it;
+}
+
+// mMutex must be held
+XdgDesktopFileList XdgMimeAppsNativeBackend::desktopFiles(const QStringList &ids)
+{
+    XdgDesktopFileList dl;
+    dl.reserve(ids.size());
+    for (const QString &id : ids) {
+        const XdgDesktopFile &df = entry(id);
+        if (df.isValid())
+            dl.append(df);
+    }
+    return dl;
+}
+
+// The installed apps associated with the type. mMutex must be held.
+QStringList XdgMimeAppsNativeBackend::desktopIds(const QString &mimeType, bool includeFallback)
+{
+    ensureIndex();
+    QStringList hits;
+    QStringList blocklist;
+    const QStringList types = mimeTypeChain(mimeType, includeFallback);
+    for (const QString &type : types)
+        mimeLookup(*mIndex, mimeTypeNames(type), &hits, &blocklist);
+
+    hits.removeIf([this] (const QString &id) { return !entry(id).isValid(); });
+    return hits;
+}
+
+/*
+ * The first installed app among the defaults of the type, then among its
+ * associations, then the same for each of its parents. mMutex must be held.
+ */
+QString XdgMimeAppsNativeBackend::defaultId(const QString &mimeType)
+{
+    ensureIndex();
+    QStringList blocklist;
+    const QStringList types = mimeTypeChain(mimeType, true);
+    for (const QString &type : types) {
+        const QStringList names = mimeTypeNames(type);
+        QStringList results;
+        for (const MimeAssociations &dir : std::as_const(mIndex->dirs)) {
+            for (const QString &name : names)
+                expand(results, dir.defaults.value(name));
+        }
+        mimeLookup(*mIndex, names, &results, &blocklist);
+
+        for (const QString &id : std::as_const(results)) {
+            if (entry(id).isValid())
+                return id;
+        }
+    }
+    return QString();
+}
+
+XdgDesktopFileList XdgMimeAppsNativeBackend::allApps()
+{
+    QMutexLocker locker(&mMutex);
+    ensureIndex();
+    return desktopFiles(mIndex->appIds);
+}
+
+XdgDesktopFileList XdgMimeAppsNativeBackend::categoryApps(const QString &category)
+{
+    QMutexLocker locker(&mMutex);
+    ensureIndex();
+    if (!mIndex->categories) {
+        auto &categories = mIndex->categories.emplace();
+        for (const QString &id : std::as_const(mIndex->appIds)) {
+            const XdgDesktopFile &df = entry(id);
+            if (df.isValid())
+                indexCategories(id, df, &categories);
+        }
+    }
+    return desktopFiles(mIndex->categories->value(category.toUpper()));
+}
+
+XdgDesktopFileList XdgMimeAppsNativeBackend::apps(const QString &mimeType)
+{
+    QMutexLocker locker(&mMutex);
+    return desktopFiles(desktopIds(mimeType, true));
+}
+
+XdgDesktopFile XdgMimeAppsNativeBackend::defaultApp(const QString &mimeType)
+{
+    QMutexLocker locker(&mMutex);
+    const QString id = defaultId(mimeType);
+    if (id.isEmpty())
+        return XdgDesktopFile();
+    return entry(id);
+}
+
+XdgDesktopFileList XdgMimeAppsNativeBackend::fallbackApps(const QString &mimeType)
+{
+    QMutexLocker locker(&mMutex);
+    // The ones of the parent types only
+    QStringList ids = desktopIds(mimeType, true);
+    const QStringList recommended = desktopIds(mimeType, false);
+    ids.removeIf([&recommended] (const QString &id) { return recommended.contains(id); });
+    return desktopFiles(ids);
+}
+
+XdgDesktopFileList XdgMimeAppsNativeBackend::recommendedApps(const QString &mimeType)
+{
+    QMutexLocker locker(&mMutex);
+    return desktopFiles(desktopIds(mimeType, false));
+}
+
+// Adds or removes the association in the user's mimeapps.list, like GIO
+bool XdgMimeAppsNativeBackend::updateUserList(const QString &mimeType, const XdgDesktopFile &app, bool add)
+{
+    const QString id = XdgDesktopFile::id(app.fileName());
+    if (id.isEmpty()) {
+        qCWarning(QtXdgMimeAppsNative, "'%s' isn't an installed desktop file",
+                  qPrintable(app.fileName()));
+        return false;
+    }
+
+    QMutexLocker writeLocker(&mWriteMutex);
+    MimeAppsListFile list(XdgDirs::configHome(true) + "/mimeapps.list"_L1);
+    QStringList added = list.value(addedGroup, mimeType);
+    QStringList removed = list.value(removedGroup, mimeType);
+    if (add) {
+        if (!added.contains(id))
+            added.append(id);
+        removed.removeAll(id);
+    } else {
+        added.removeAll(id);
+        if (!removed.contains(id))
+            removed.append(id);
+        QStringList defaults = list.value(defaultGroup, mimeType);
+        defaults.removeAll(id);
+        list.setValue(defaultGroup, mimeType, defaults);
+    }
+    list.setValue(addedGroup, mimeType, added);
+    list.setValue(removedGroup, mimeType, removed);
+
+    if (!list.save()) {
+        qCWarning(QtXdgMimeAppsNative, "Failed to update the associations of '%s' with '%s'",
+                  qPrintable(mimeType), qPrintable(id));
+        return false;
+    }
+    return true;
+}
+
+// Like the GIO monitor, the changes made here are reported too. Don't wait
+// for the watcher, the next queries must see them.
+bool XdgMimeAppsNativeBackend::addAssociation(const QString &mimeType, const XdgDesktopFile &app)
+{
+    if (!updateUserList(mimeType, app, true))
+        return false;
+    reloadUserLists();
+    return true;
+}
+
+bool XdgMimeAppsNativeBackend::removeAssociation(const QString &mimeType, const XdgDesktopFile &app)
+{
+    if (!updateUserList(mimeType, app, false))
+        return false;
+    reloadUserLists();
+    return true;
+}
+
+bool XdgMimeAppsNativeBackend::reset(const QString &mimeType)
+{
+    QMutexLocker writeLocker(&mWriteMutex);
+    MimeAppsListFile list(XdgDirs::configHome(true) + "/mimeapps.list"_L1);
+    list.setValue(defaultGroup, mimeType, QStringList());
+    list.setValue(addedGroup, mimeType, QStringList());
+    list.setValue(removedGroup, mimeType, QStringList());
+    if (!list.save())
+        return false;
+
+    writeLocker.unlock();
+    reloadUserLists();
+    return true;
+}
+
+bool XdgMimeAppsNativeBackend::setDefaultApp(const QString &mimeType, const XdgDesktopFile &app)
+{
+    // Like the GLib backend, the default is only set for the current desktop
+    if (!updateUserList(mimeType, app, true))
+        return false;
+
+    const QStringList desktops = currentDesktops();
+    const QString fileName = desktops.isEmpty() ? u"mimeapps.list"_s : desktops.first() + "-mimeapps.list"_L1;
+    QMutexLocker writeLocker(&mWriteMutex);
+    MimeAppsListFile list(XdgDirs::configHome(true) + u'/' + fileName);
+    list.setValue(defaultGroup, mimeType, QStringList(XdgDesktopFile::id(app.fileName())));
+    if (!list.save()) {
+        qCWarning(QtXdgMimeAppsNative, "Failed to set '%s' as the default for '%s'",
+                  qPrintable(app.fileName()), qPrintable(mimeType));
+        return false;
+    }
+
+    writeLocker.unlock();
+
+    qCDebug(QtXdgMimeAppsNative, "Set '%s' as the default for '%s'",
+            qPrintable(app.fileName()), qPrintable(mimeType));
+    reloadUserLists();
+    return true;
+}
+
+void XdgMimeAppsNativeBackend::directoryChanged(const QString &path)
+{
+    mChangedPaths.insert(path);
+    mChangeTimer->start();
+}
+
+void XdgMimeAppsNativeBackend::checkChanges()
+{
+    const QSet<QString> paths = std::exchange(mChangedPaths, QSet<QString>());
+    bool changed = false;
+    {
+        QMutexLocker locker(&mMutex);
+        // Nothing was read yet, the first query reads the files as they are
+        if (!mIndex)
+            return;
+        for (auto it = paths.cbegin(); !changed && it != paths.cend(); ++it)
+            changed = mIndex->appDirs.contains(*it);
+        if (!changed) {
+            for (auto it = mIndex->listStamps.cbegin(); it != mIndex->listStamps.cend(); ++it) {
+                if (QFileInfo(it.key()).lastModified() != it.value()) {
+                    changed = true;
+                    break;
+                }
+            }
+        }
+    }
+    if (changed)
+        update();
+}
+
+void XdgMimeAppsNativeBackend::trackChanges()
+{
+    QMutexLocker locker(&mMutex);
+    if (mTrackChanges)
+        return;
+    // The index to compare with needs the times of the files
+    mTrackChanges = true;
+    mIndex.reset();
+    ensureIndex();
+}
+
+// Adds the types whose associations differ in the list files
+static void diffAssociations(const QList<MimeAssociations> &before, const QList<MimeAssociations> &after,
+                             QSet<QString> *mimeTypes)
+{
+    const auto diff = [mimeTypes] (const QHash<QString, QStringList> &a, const QHash<QString, QStringList> &b) {
+        for (auto it = a.cbegin(); it != a.cend(); ++it) {
+            if (b.value(it.key()) != it.value())
+                mimeTypes->insert(it.key());
+        }
+        for (auto it = b.cbegin(); it != b.cend(); ++it) {
+            if (!a.contains(it.key()))
+                mimeTypes->insert(it.key());
+        }
+    };
+
+    const qsizetype count = std::max(before.size(), after.size());
+    for (qsizetype i = 0; i < count; ++i) {
+        const MimeAssociations a = before.value(i);
+        const MimeAssociations b = after.value(i);
+        diff(a.defaults, b.defaults);
+        diff(a.additions, b.additions);
+        diff(a.removals, b.removals);
+    }
+}
+
+/*
+ * Reads the user's list files again once they were written here, and
+ * reports the change. Their new times are kept, the watcher then finds
+ * nothing to report again. Like GIO, only the user's directory is written.
+ */
+void XdgMimeAppsNativeBackend::reloadUserLists()
+{
+    QSet<QString> mimeTypes;
+    {
+        QMutexLocker locker(&mMutex);
+        if (mIndex && !mIndex->dirs.isEmpty()) {
+            const QList<MimeAssociations> before = mIndex->dirs;
+            mIndex->dirs[0] = readLists(XdgDirs::configHome(false), true, currentDesktops(), &mIndex->listStamps);
+            if (mTrackChanges)
+                diffAssociations(before, mIndex->dirs, &mimeTypes);
+        }
+    }
+    reportChanges(QStringList(), QStringList(), QStringList(), mimeTypes);
+}
+
+/*
+ * Drops the index and reports the change. While tracking, the new index is
+ * built right away and compared with the old one: the apps by their files,
+ * the types by their associations and by the apps that changed.
+ */
+void XdgMimeAppsNativeBackend::update()
+{
+    QStringList added;
+    QStringList removed;
+    QStringList modified;
+    QSet<QString> mimeTypes;
+    {
+        QMutexLocker locker(&mMutex);
+        const std::unique_ptr<XdgMimeAppsIndex> old = std::move(mIndex);
+        const QHash<QString, XdgDesktopFile> entries = std::exchange(mEntries, QHash<QString, XdgDesktopFile>());
+
+        if (mTrackChanges && old) {
+            ensureIndex();
+            const auto stamps = [] (const XdgMimeAppsIndex &index) {
+                AppStamps stamps;
+                for (auto it = index.apps.cbegin(); it != index.apps.cend(); ++it)
+                    stamps.insert(it.key(), {it->fileName, it->modified});
+                return stamps;
+            };
+            diffApps(stamps(*old), stamps(*mIndex), &added, &removed, &modified);
+
+            // The unchanged apps aren't parsed again
+            for (auto it = entries.cbegin(); it != entries.cend(); ++it) {
+                if (mIndex->apps.contains(it.key()) && !modified.contains(it.key()))
+                    mEntries.insert(it.key(), it.value());
+            }
+            for (const QString &id : std::as_const(removed))
+                addMimeTypes(entries.value(id), &mimeTypes);
+            for (const QString &id : std::as_const(modified)) {
+                addMimeTypes(entries.value(id), &mimeTypes);
+                addMimeTypes(entry(id), &mimeTypes);
+            }
+            for (const QString &id : std::as_const(added))
+                addMimeTypes(entry(id), &mimeTypes);
+            diffAssociations(old->dirs, mIndex->dirs, &mimeTypes);
+        }
+    }
+    reportChanges(added, removed, modified, mimeTypes);
+}
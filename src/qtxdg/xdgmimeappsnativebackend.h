@@ -0,0 +1,92 @@
+/*
+ * libqtxdg - An Qt implementation of freedesktop.org xdg specs
+ * Copyright (C) 2026  LXQt team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#ifndef XDGMIMEAPPSNATIVEBACKEND_H
+#define XDGMIMEAPPSNATIVEBACKEND_H
+
+#include "xdgmimeappsbackendinterface.h"
+#include "xdgdesktopfile.h"
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QStringList>
+
+#include <memory>
+
+class QFileSystemWatcher;
+class QTimer;
+struct XdgMimeAppsIndex;
+
+class QString;
+
+/*
+ * Reads mimeapps.list (the desktop specific ones too), defaults.list and
+ * mimeinfo.cache itself, following the lookups of GIO. The files are parsed
+ * into an index on the first query and kept until they change.
+ */
+class Q_DECL_HIDDEN XdgMimeAppsNativeBackend : public XdgMimeAppsBackendInterface {
+public:
+    XdgMimeAppsNativeBackend(QObject *parent);
+    ~XdgMimeAppsNativeBackend() override;
+
+    bool addAssociation(const QString &mimeType, const XdgDesktopFile &app) override;
+    XdgDesktopFileList allApps() override;
+    XdgDesktopFileList apps(const QString &mimeType) override;
+    XdgDesktopFile defaultApp(const QString &mimeType) override;
+    XdgDesktopFileList categoryApps(const QString &category) override;
+    XdgDesktopFileList fallbackApps(const QString &mimeType) override;
+    XdgDesktopFileList recommendedApps(const QString &mimeType) override;
+    bool removeAssociation(const QString &mimeType, const XdgDesktopFile &app) override;
+    bool reset(const QString &mimeType) override;
+    bool setDefaultApp(const QString &mimeType, const XdgDesktopFile &app) override;
+    void trackChanges() override;
+
+private:
+    void ensureIndex();
+    QStringList desktopIds(const QString &mimeType, bool includeFallback);
+    QString defaultId(const QString &mimeType);
+    const XdgDesktopFile &entry(const QString &id);
+    XdgDesktopFileList desktopFiles(const QStringList &ids);
+    bool updateUserList(const QString &mimeType, const XdgDesktopFile &app, bool add);
+    void directoryChanged(const QString &path);
+    void checkChanges();
+    void reloadUserLists();
+    void update();
+
+    // Guards the index and the parsed entries, the queries may come from
+    // several threads
+    QMutex mMutex;
+    // Serializes the edits of the list files, each one reads, changes and
+    // writes a file
+    QMutex mWriteMutex;
+    std::unique_ptr<XdgMimeAppsIndex> mIndex;
+    // The parsed desktop file of each id, invalid if it isn't installed
+    QHash<QString, XdgDesktopFile> mEntries;
+    // The index keeps the times of the desktop files to be compared
+    bool mTrackChanges = false;
+
+    QFileSystemWatcher *mWatcher;
+    // Coalesces the notifications, a package install changes many files
+    QTimer *mChangeTimer;
+    QSet<QString> mChangedPaths;
+};
+
+#endif // XDGMIMEAPPSNATIVEBACKEND_H
@@ -40,6 +40,7 @@
 #include <private/qicon_p.h>
 
 #include <cmath>
+#include <cstring>
 
 #include <QtGui/QIconEnginePlugin>
 #include <QtGui/QPixmapCache>
@@ -49,15 +50,24 @@
 #include <QtCore/qmath.h>
 #include <QtCore/QList>
 #include <QtCore/QDir>
-#include <QtCore/QSettings>
+#include <QtCore/QDataStream>
 #include <QtCore/QStringView>
+#include <QtCore/QStringEncoder>
+#include <QtCore/QVarLengthArray>
+#include <QtCore/QtEndian>
+#include <QtCore/QSemaphore>
+#include <QtCore/QThread>
 #include <QtGui/QPainter>
 #include <QImageReader>
 #include <QXmlStreamReader>
 #include <QFileSystemWatcher>
 #include <QSvgRenderer>
-
-#include <private/qhexstring_p.h>
+#include <QCache>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
 
 using namespace Qt::Literals::StringLiterals;
 
@@ -92,12 +102,28 @@ void XdgIconLoader::setFollowColorScheme(bool enable)
     }
 }
 
+static bool isGuiThread()
+{
+    const QCoreApplication *app = QCoreApplication::instance();
+    return app && QThread::currentThread() == app->thread();
+}
+
 XdgIconLoader *XdgIconLoader::instance()
 {
-   QIconLoader::instance()->ensureInitialized();
+   // QIconLoader isn't thread-safe, see currentTheme()
+   if (isGuiThread())
+       QIconLoader::instance()->ensureInitialized();
    return iconLoaderInstance();
 }
 
+uint XdgIconLoader::themeKey() const
+{
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+    return key;
+}
+
 /*!
     \class QIconCacheGtkReader
     \internal
@@ -110,15 +136,29 @@ class QIconCacheGtkReader
 {
 public:
     explicit QIconCacheGtkReader(const QString &themeDir);
-    QList<const char *> lookup(QStringView);
-    bool isValid() const { return m_isValid; }
-    bool reValid(bool infoRefresh);
+    bool findSubDirs(QStringView name, const QList<QIconDirInfo> &dirs, QList<QIconDirInfo> *subDirs);
 private:
+    using SubDirNames = QVarLengthArray<const char *, 16>;
+    void lookup(QStringView name, SubDirNames *result);
+    bool nameMatches(quint32 offset, QStringView asciiName, QByteArrayView utf8Name) const;
+    bool reValid(bool infoRefresh);
+    void revalidate();
+    void pathChanged(const QString &path);
+
+    // The lookups can run on several threads at once and only read the
+    // mapped file. Remapping it needs the write lock. The watcher merely
+    // flags what changed, from the GUI thread; the checks are deferred to
+    // the next lookup.
+    QReadWriteLock m_lock;
+    QString m_themeDir;
     QFileInfo m_cacheFileInfo;
     QFile m_file;
     const unsigned char *m_data;
     quint64 m_size;
-    bool m_isValid;
+    std::atomic<bool> m_isValid;
+    // The theme directory or the cache file changed, the cache may have
+    // been replaced
+    std::atomic<bool> m_themeDirChanged{true};
 
     quint16 read16(uint offset)
     {
@@ -126,7 +166,7 @@ private:
             m_isValid = false;
             return 0;
         }
-        return m_data[offset+1] | m_data[offset] << 8;
+        return qFromBigEndian<quint16>(m_data + offset);
     }
     quint32 read32(uint offset)
     {
@@ -134,15 +174,29 @@ private:
             m_isValid = false;
             return 0;
         }
-        return m_data[offset+3] | m_data[offset+2] << 8
-            | m_data[offset+1] << 16 | m_data[offset] << 24;
+        return qFromBigEndian<quint32>(m_data + offset);
+    }
+};
+
+namespace {
+class GtkCachesWatcher : public QFileSystemWatcher
+{
+public:
+    GtkCachesWatcher()
+    {
+        // The readers may be created on the prewarming thread, but the
+        // watcher needs a thread with a running event loop
+        if (QCoreApplication *app = QCoreApplication::instance())
+            moveToThread(app->thread());
     }
 };
-Q_GLOBAL_STATIC(QFileSystemWatcher, gtkCachesWatcher)
+}
+Q_GLOBAL_STATIC(GtkCachesWatcher, gtkCachesWatcher)
 
 
 QIconCacheGtkReader::QIconCacheGtkReader(const QString &dirName)
-    : m_cacheFileInfo{dirName + "/icon-theme.cache"_L1}
+    : m_themeDir(dirName)
+    , m_cacheFileInfo{dirName + "/icon-theme.cache"_L1}
     , m_data(nullptr)
     , m_isValid(false)
 {
@@ -150,21 +204,58 @@ QIconCacheGtkReader::QIconCacheGtkReader(const QString &dirName)
     // Note: The cache file can be (IS) removed and newly created during the
     // cache update. But we hold open file descriptor for the "old" removed
     // file. So we need to watch the changes and reopen/remap the file.
-    gtkCachesWatcher->addPath(dirName);
-    QObject::connect(gtkCachesWatcher(), &QFileSystemWatcher::directoryChanged, &m_file, [this]
+    // The cache file itself is watched too once it's mapped, it may also be
+    // rewritten in place. The icon directories aren't, big themes have
+    // hundreds of them.
+    QFileSystemWatcher *watcher = gtkCachesWatcher();
+    m_file.moveToThread(watcher->thread());
+    QMetaObject::invokeMethod(watcher, [watcher, dirName] { watcher->addPath(dirName); });
+    QObject::connect(watcher, &QFileSystemWatcher::directoryChanged, &m_file, [this] (const QString &path)
         {
-            m_isValid = false;
-            // invalidate icons to reload them ...
-            QIconLoader::instance()->invalidateKey();
+            pathChanged(path);
+        });
+    QObject::connect(watcher, &QFileSystemWatcher::fileChanged, &m_file, [this] (const QString &path)
+        {
+            pathChanged(path);
         });
-    reValid(false);
+    // The cache is only mapped and checked by the first lookup
+}
+
+void QIconCacheGtkReader::pathChanged(const QString &path)
+{
+    if (path != m_themeDir && path != m_file.fileName())
+        return;
+    m_themeDirChanged = true;
+    // reload the icons looked up through this directory only
+    iconLoaderInstance()->invalidateContentDir(m_themeDir);
+}
+
+// Handles the changes reported by the watcher, m_lock must be held for writing
+void QIconCacheGtkReader::revalidate()
+{
+    m_themeDirChanged = false;
+    const QDateTime lastModified = m_cacheFileInfo.lastModified();
+    const qint64 size = m_cacheFileInfo.size();
+    m_cacheFileInfo.refresh();
+    // Something else in the theme directory changed, the mapped cache
+    // is still the current one and its icon directories were checked
+    if (m_data && m_cacheFileInfo.exists() && m_cacheFileInfo.lastModified() == lastModified
+        && m_cacheFileInfo.size() == size)
+    {
+        if (m_isValid && lastModified < QFileInfo(m_themeDir).lastModified())
+            m_isValid = false;
+    } else {
+        reValid(false);
+    }
 }
 
 bool QIconCacheGtkReader::reValid(bool infoRefresh)
 {
     if (m_data)
         m_file.unmap(const_cast<unsigned char *>(m_data));
+    m_data = nullptr;
     m_file.close();
+    m_isValid = false;
 
     if (infoRefresh)
         m_cacheFileInfo.refresh();
@@ -185,7 +276,8 @@ bool QIconCacheGtkReader::reValid(bool infoRefresh)
 
     m_isValid = true;
 
-    // Check that all the directories are older than the cache
+    // Check that all the directories are older than the cache, once per
+    // mapping
     auto lastModified = m_cacheFileInfo.lastModified();
     quint32 dirListOffset = read32(8);
     quint32 dirListLen = read32(dirListOffset);
@@ -197,45 +289,135 @@ bool QIconCacheGtkReader::reValid(bool infoRefresh)
             return m_isValid;
         }
     }
+
+    // A replaced file isn't watched anymore, the new one is added again
+    QFileSystemWatcher *watcher = gtkCachesWatcher();
+    const QString fileName = m_file.fileName();
+    QMetaObject::invokeMethod(watcher, [watcher, fileName] {
+        if (!watcher->files().contains(fileName))
+            watcher->addPath(fileName);
+    });
     return m_isValid;
 }
 
-static quint32 icon_name_hash(const char *p)
+/*! \internal
+    Fills \a subDirs with the entries of \a dirs in which an icon named \a name
+    is present. Returns false if the cache can't be used for the lookup.
+ */
+bool QIconCacheGtkReader::findSubDirs(QStringView name, const QList<QIconDirInfo> &dirs, QList<QIconDirInfo> *subDirs)
+{
+    if (m_themeDirChanged) {
+        QWriteLocker writeLocker(&m_lock);
+        // Another thread may have handled the changes meanwhile
+        if (m_themeDirChanged)
+            revalidate();
+    }
+
+    // An outdated or broken cache stays unused until it changes again
+    QReadLocker locker(&m_lock);
+    if (!m_isValid)
+        return false;
+
+    SubDirNames result;
+    lookup(name, &result);
+    if (!m_isValid)
+        return false;
+
+    subDirs->clear();
+    subDirs->reserve(result.size());
+    for (const char *s : std::as_const(result)) {
+        const QUtf8StringView path(s);
+        auto it = std::find_if(dirs.cbegin(), dirs.cend(),
+                               [&](const QIconDirInfo &info) {
+                                   return QAnyStringView::equal(info.path, path); } );
+        if (it != dirs.cend()) {
+            subDirs->append(*it);
+        }
+    }
+    return true;
+}
+
+// The hash of gtk-update-icon-cache, over the UTF-8 bytes of the name
+static quint32 icon_name_hash(QByteArrayView name)
 {
-    quint32 h = static_cast<signed char>(*p);
-    for (p += 1; *p != '\0'; p++)
-        h = (h << 5) - h + *p;
+    quint32 h = static_cast<signed char>(name.front());
+    for (qsizetype i = 1; i < name.size(); ++i)
+        h = (h << 5) - h + static_cast<signed char>(name.at(i));
     return h;
 }
 
+// Hashes an ASCII name as is, its UTF-8 bytes are its characters. Returns
+// false if it isn't ASCII.
+static bool icon_name_hash(QStringView name, quint32 *hash)
+{
+    quint32 h = 0;
+    for (const QChar c : name) {
+        if (c.unicode() > 0x7f)
+            return false;
+        h = (h << 5) - h + c.unicode();
+    }
+    *hash = h;
+    return true;
+}
+
+// Compares the name stored at offset with either name, without reading
+// past the mapped data
+bool QIconCacheGtkReader::nameMatches(quint32 offset, QStringView asciiName, QByteArrayView utf8Name) const
+{
+    const qsizetype length = utf8Name.isNull() ? asciiName.size() : utf8Name.size();
+    if (offset >= m_size || m_size - offset <= quint64(length))
+        return false;
+    const unsigned char *s = m_data + offset;
+    if (s[length] != '\0')
+        return false;
+    if (!utf8Name.isNull())
+        return std::memcmp(s, utf8Name.data(), length) == 0;
+    for (qsizetype i = 0; i < length; ++i) {
+        if (s[i] != asciiName.at(i).unicode())
+            return false;
+    }
+    return true;
+}
+
 /*! \internal
-    lookup the icon name and return the list of subdirectories in which an icon
-    with this name is present. The char* are pointers to the mapped data.
+    lookup the icon name and fill \a result with the subdirectories in which an
+    icon with this name is present. The char* are pointers to the mapped data.
     For example, this would return { "32x32/apps", "24x24/apps" , ... }
+
+    Names are looked up without allocating: ASCII ones (nearly all of them)
+    are hashed and compared as they are, the others are encoded on the stack.
  */
 
-QList<const char *> QIconCacheGtkReader::lookup(QStringView name)
+void QIconCacheGtkReader::lookup(QStringView name, SubDirNames *result)
 {
-    QList<const char *> ret;
-    if (!isValid() || name.isEmpty())
-        return ret;
-
-    QByteArray nameUtf8 = name.toUtf8();
-    quint32 hash = icon_name_hash(nameUtf8.data());
+    result->clear();
+    if (!m_isValid || name.isEmpty())
+        return;
+
+    quint32 hash;
+    QVarLengthArray<char, 256> utf8;
+    QByteArrayView utf8Name;
+    if (!icon_name_hash(name, &hash)) {
+        QStringEncoder encoder(QStringEncoder::Utf8);
+        utf8.resize(encoder.requiredSpace(name.size()));
+        const char *end = encoder.appendToBuffer(utf8.data(), name);
+        utf8Name = QByteArrayView(utf8.constData(), end);
+        hash = icon_name_hash(utf8Name);
+    }
 
     quint32 hashOffset = read32(4);
     quint32 hashBucketCount = read32(hashOffset);
 
-    if (!isValid() || hashBucketCount == 0) {
+    if (!m_isValid || hashBucketCount == 0) {
         m_isValid = false;
-        return ret;
+        return;
     }
 
     quint32 bucketIndex = hash % hashBucketCount;
     quint32 bucketOffset = read32(hashOffset + 4 + bucketIndex * 4);
     while (bucketOffset > 0 && bucketOffset <= m_size - 12) {
         quint32 nameOff = read32(bucketOffset + 4);
-        if (nameOff < m_size && strcmp(reinterpret_cast<const char*>(m_data + nameOff), nameUtf8.constData()) == 0) {
+        if (nameMatches(nameOff, name, utf8Name)) {
             quint32 dirListOffset = read32(8);
             quint32 dirListLen = read32(dirListOffset);
 
@@ -244,33 +426,213 @@ QList<const char *> QIconCacheGtkReader::lookup(QStringView name)
 
             if (!m_isValid || listOffset + 4 + 8 * listLen > m_size) {
                 m_isValid = false;
-                return ret;
+                return;
             }
 
-            ret.reserve(listLen);
+            result->reserve(listLen);
             for (uint j = 0; j < listLen && m_isValid; ++j) {
                 quint32 dirIndex = read16(listOffset + 4 + 8 * j);
                 quint32 o = read32(dirListOffset + 4 + dirIndex*4);
                 if (!m_isValid || dirIndex >= dirListLen || o >= m_size) {
                     m_isValid = false;
-                    return ret;
+                    return;
                 }
-                ret.append(reinterpret_cast<const char*>(m_data) + o);
+                result->append(reinterpret_cast<const char*>(m_data) + o);
             }
-            return ret;
+            return;
         }
         bucketOffset = read32(bucketOffset);
     }
-    return ret;
 }
 
-XdgIconTheme::XdgIconTheme(const QString &themeName)
+namespace {
+// What the icon loader needs from an index.theme file
+struct ThemeIndex
+{
+    QList<QIconDirInfo> dirs;
+    QStringList parents;
+    bool followsColorScheme = false;
+};
+}
+
+/*
+ * A single pass over index.theme, filling QIconDirInfo as it goes. It knows
+ * just enough of the desktop entry syntax for the keys used here. All the
+ * groups with a non-zero Size are taken as directories, in the order of the
+ * file.
+ */
+static ThemeIndex parseThemeIndex(QByteArrayView data)
+{
+    ThemeIndex index;
+
+    QIconDirInfo dir;
+    int threshold = -1;
+    int minSize = -1;
+    int maxSize = -1;
+    bool inThemeGroup = false;
+    bool inDirGroup = false;
+
+    const auto finishDir = [&] {
+        if (inDirGroup && dir.size != 0) {
+            dir.threshold = threshold == -1 ? 2 : threshold;
+            dir.minSize = minSize == -1 ? dir.size : minSize;
+            dir.maxSize = maxSize == -1 ? dir.size : maxSize;
+            index.dirs.append(dir);
+        }
+        inDirGroup = false;
+    };
+
+    while (!data.isEmpty()) {
+        qsizetype end = data.indexOf('\n');
+        if (end == -1)
+            end = data.size();
+        const QByteArrayView line = data.first(end).trimmed();
+        data = data.sliced(std::min(end + 1, data.size()));
+
+        if (line.isEmpty() || line.front() == '#' || line.front() == ';')
+            continue;
+
+        if (line.front() == '[' && line.back() == ']') {
+            finishDir();
+            const QByteArrayView group = line.sliced(1, line.size() - 2);
+            inThemeGroup = group == "Icon Theme";
+            if (!inThemeGroup) {
+                inDirGroup = true;
+                dir = QIconDirInfo(QString::fromUtf8(group));
+                threshold = minSize = maxSize = -1;
+            }
+            continue;
+        }
+
+        const qsizetype equal = line.indexOf('=');
+        if (equal == -1)
+            continue;
+        const QByteArrayView key = line.first(equal).trimmed();
+        const QByteArrayView value = line.sliced(equal + 1).trimmed();
+
+        if (inThemeGroup) {
+            if (key == "Inherits") {
+                const QList<QByteArray> parents = value.toByteArray().split(',');
+                for (const QByteArray &parent : parents) {
+                    const QByteArray name = parent.trimmed();
+                    if (!name.isEmpty())
+                        index.parents.append(QString::fromUtf8(name));
+                }
+            } else if (key == "FollowsColorScheme") {
+                index.followsColorScheme = !value.isEmpty() && value != "0"
+                    && value.compare("false", Qt::CaseInsensitive) != 0;
+            }
+        } else if (inDirGroup) {
+            if (key == "Size")
+                dir.size = value.toInt();
+            else if (key == "Type")
+                dir.type = value == "Fixed" ? QIconDirInfo::Fixed
+                         : value == "Scalable" ? QIconDirInfo::Scalable
+                         : QIconDirInfo::Threshold;
+            else if (key == "Threshold")
+                threshold = value.toInt();
+            else if (key == "MinSize")
+                minSize = value.toInt();
+            else if (key == "MaxSize")
+                maxSize = value.toInt();
+            else if (key == "Scale")
+                dir.scale = value.toInt();
+        }
+    }
+    finishDir();
+    return index;
+}
+
+/*
+ * The parsed index.theme files are also kept next to the rasterized icons
+ * when the disk cache is enabled, so that the other processes don't have to
+ * parse themes with over a thousand directories again. The modification
+ * time and the size of the file are checked like for the icons.
+ */
+static const quint32 ThemeIndexCacheVersion = 1;
+
+static QString themeIndexCacheFile(const QString &fileName)
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+        + "/qtxdg/themes/"_L1
+        + QString::fromLatin1(QCryptographicHash::hash(fileName.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+static bool readCachedThemeIndex(const QString &fileName, const QFileInfo &source, ThemeIndex *index)
+{
+    QFile file(themeIndexCacheFile(fileName));
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_6_0);
+    quint32 version;
+    qint64 mtime, size;
+    in >> version >> mtime >> size;
+    if (in.status() != QDataStream::Ok || version != ThemeIndexCacheVersion
+        || mtime != source.lastModified().toMSecsSinceEpoch() || size != source.size())
+    {
+        return false;
+    }
+
+    qint32 count;
+    in >> index->followsColorScheme >> index->parents >> count;
+    if (in.status() != QDataStream::Ok || count < 0)
+        return false;
+    index->dirs.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        QIconDirInfo dir;
+        qint32 type;
+        in >> dir.path >> dir.size >> dir.maxSize >> dir.minSize >> dir.threshold >> dir.scale >> type;
+        dir.type = QIconDirInfo::Type(type);
+        index->dirs.append(dir);
+    }
+    return in.status() == QDataStream::Ok;
+}
+
+static void writeCachedThemeIndex(const QString &fileName, const QFileInfo &source, const ThemeIndex &index)
+{
+    const QString cacheFile = themeIndexCacheFile(fileName);
+    if (!QDir().mkpath(QFileInfo(cacheFile).path()))
+        return;
+
+    QSaveFile file(cacheFile);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QDataStream out(&file);
+    // The file is read by other processes, maybe built against another Qt
+    out.setVersion(QDataStream::Qt_6_0);
+    out << ThemeIndexCacheVersion << source.lastModified().toMSecsSinceEpoch() << source.size();
+    out << index.followsColorScheme << index.parents << qint32(index.dirs.size());
+    for (const QIconDirInfo &dir : index.dirs)
+        out << dir.path << dir.size << dir.maxSize << dir.minSize << dir.threshold << dir.scale << qint32(dir.type);
+    file.commit();
+}
+
+static ThemeIndex readThemeIndex(const QString &fileName)
+{
+    ThemeIndex index;
+    const bool useCache = iconLoaderInstance()->diskCacheEnabled();
+    const QFileInfo source(fileName);
+    if (useCache && readCachedThemeIndex(fileName, source, &index))
+        return index;
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return index;
+    index = parseThemeIndex(file.readAll());
+    if (useCache)
+        writeCachedThemeIndex(fileName, source, index);
+    return index;
+}
+
+XdgIconTheme::XdgIconTheme(const QString &themeName, const QStringList &iconDirs)
         : m_valid(false)
         , m_followsColorScheme(false)
 {
     QFile themeIndex;
 
-    const QStringList iconDirs = QIcon::themeSearchPaths();
     for ( int i = 0 ; i < iconDirs.size() ; ++i) {
         QDir iconDir(iconDirs[i]);
         QString themeDir = iconDir.path() + u'/' + themeName;
@@ -287,53 +649,14 @@ XdgIconTheme::XdgIconTheme(const QString &themeName)
                 m_valid = true;
         }
     }
-#ifndef QT_NO_SETTINGS
-    if (themeIndex.exists()) {
-        const QSettings indexReader(themeIndex.fileName(), QSettings::IniFormat);
-        m_followsColorScheme = indexReader.value(u"Icon Theme/FollowsColorScheme"_s, false).toBool();
-        const QStringList keys = indexReader.allKeys();
-        for (auto const &key : keys) {
-            if (key.endsWith("/Size"_L1)) {
-                // Note the QSettings ini-format does not accept
-                // slashes in key names, hence we have to cheat
-                if (int size = indexReader.value(key).toInt()) {
-                    QString directoryKey = key.left(key.size() - 5);
-                    QIconDirInfo dirInfo(directoryKey);
-                    dirInfo.size = size;
-                    QString type = indexReader.value(directoryKey +
-                                                     "/Type"_L1
-                                                     ).toString();
-
-                    if (type == "Fixed"_L1)
-                        dirInfo.type = QIconDirInfo::Fixed;
-                    else if (type == "Scalable"_L1)
-                        dirInfo.type = QIconDirInfo::Scalable;
-                    else
-                        dirInfo.type = QIconDirInfo::Threshold;
-
-                    dirInfo.threshold = indexReader.value(directoryKey +
-                                                        "/Threshold"_L1,
-                                                        2).toInt();
-
-                    dirInfo.minSize = indexReader.value(directoryKey +
-                                                         "/MinSize"_L1,
-                                                         size).toInt();
-
-                    dirInfo.maxSize = indexReader.value(directoryKey +
-                                                        "/MaxSize"_L1,
-                                                        size).toInt();
-                    dirInfo.scale = indexReader.value(directoryKey +
-                                                      "/Scale"_L1,
-                                                      1).toInt();
-                    m_keyList.append(dirInfo);
-                }
-            }
-        }
+
+    if (m_valid) {
+        const ThemeIndex index = readThemeIndex(themeIndex.fileName());
+        m_followsColorScheme = index.followsColorScheme;
+        m_keyList = index.dirs;
 
         // Parent themes provide fallbacks for missing icons
-        m_parents = indexReader.value(
-                "Icon Theme/Inherits"_L1).toStringList();
-        m_parents.removeAll(QString());
+        m_parents = index.parents;
 
         // Ensure a default platform fallback for all themes
         if (m_parents.isEmpty()) {
@@ -342,7 +665,123 @@ XdgIconTheme::XdgIconTheme(const QString &themeName)
                 m_parents.append(fallback);
         }
     }
-#endif //QT_NO_SETTINGS
+}
+
+XdgIconTheme XdgIconLoader::findTheme(const QString &themeName) const
+{
+    QStringList searchPaths;
+    {
+        QReadLocker locker(&m_lock);
+        const auto it = themeList.constFind(themeName);
+        if (it != themeList.constEnd() && it->isValid())
+            return *it;
+        searchPaths = m_themeSearchPaths;
+    }
+
+    // Parse the theme without holding the lock, it touches the disk
+    XdgIconTheme theme(themeName, searchPaths);
+    if (!theme.isValid()) {
+        const QString fallback = fallbackTheme();
+        if (!fallback.isEmpty())
+            theme = XdgIconTheme(fallback, searchPaths);
+    }
+
+    QWriteLocker locker(&m_lock);
+    XdgIconTheme &cached = themeList[themeName];
+    // Another thread may have been faster
+    if (!cached.isValid())
+        cached = theme;
+    return cached;
+}
+
+XdgIconTheme XdgIconLoader::theme()
+{
+    QReadLocker locker(&m_lock);
+    return themeList.value(QIconLoader::instance()->themeName());
+}
+
+/*
+ * Compact ids of the icon files, so that their rendered pixmaps are keyed by
+ * a few integers instead of the file name. Files are interned when an icon
+ * is resolved, which may happen on any thread.
+ */
+class FileIdTable
+{
+public:
+    quint32 id(const QString &filename)
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_ids.constFind(filename);
+        if (it == m_ids.constEnd())
+            it = m_ids.insert(filename, ++m_lastId);
+        return *it;
+    }
+
+    // The files in \a dir get new ids, their rendered pixmaps aren't found anymore
+    void forget(const QString &dir)
+    {
+        const QString prefix = dir + u'/';
+        QMutexLocker locker(&m_mutex);
+        m_ids.removeIf([&prefix] (const QHash<QString, quint32>::iterator it) {
+            return it.key().startsWith(prefix);
+        });
+    }
+
+private:
+    QMutex m_mutex;
+    QHash<QString, quint32> m_ids;
+    quint32 m_lastId = 0;
+};
+Q_GLOBAL_STATIC(FileIdTable, fileIdTable)
+
+// Notice we ensure that pixmap entries always come before
+// scalable to preserve search order afterwards
+static void addEntry(XdgIconInfo &info, XdgIconEntryInfo::Kind kind,
+                     const QString &filename, const QIconDirInfo &dir = QIconDirInfo())
+{
+    XdgIconEntryInfo entry;
+    entry.filename = filename;
+    entry.dir = dir;
+    entry.kind = kind;
+    entry.fileId = fileIdTable()->id(filename);
+    if (kind == XdgIconEntryInfo::Pixmap)
+        info.entries.prepend(entry);
+    else
+        info.entries.append(entry);
+}
+
+static QThemeIconInfo createThemeIconInfo(const XdgIconInfo &info)
+{
+    QThemeIconInfo themeInfo;
+    themeInfo.iconName = info.iconName;
+    themeInfo.entries.reserve(info.entries.size());
+    for (const XdgIconEntryInfo &entryInfo : info.entries) {
+        std::unique_ptr<QIconLoaderEngineEntry> entry;
+        switch (entryInfo.kind) {
+        case XdgIconEntryInfo::Pixmap: {
+            auto pixmapEntry = new XdgPixmapEntry;
+            pixmapEntry->fileId = entryInfo.fileId;
+            entry.reset(pixmapEntry);
+            break;
+        }
+        case XdgIconEntryInfo::Scalable: {
+            auto scalableEntry = new XdgScalableEntry;
+            scalableEntry->fileId = entryInfo.fileId;
+            entry.reset(scalableEntry);
+            break;
+        }
+        case XdgIconEntryInfo::ScalableFollowsColor: {
+            auto colorEntry = new ScalableFollowsColorEntry;
+            colorEntry->fileId = entryInfo.fileId;
+            entry.reset(colorEntry);
+            break;
+        }
+        }
+        entry->dir = entryInfo.dir;
+        entry->filename = entryInfo.filename;
+        themeInfo.entries.push_back(std::move(entry));
+    }
+    return themeInfo;
 }
 
 /* WARNING:
@@ -367,171 +806,207 @@ XdgIconTheme::XdgIconTheme(const QString &themeName)
  * https://github.com/lxqt/lxqt/issues/1252
  * https://github.com/lxqt/libqtxdg/pull/116
  */
-QThemeIconInfo XdgIconLoader::findIconHelper(const QString &themeName,
-                                 const QString &iconName,
-                                 QStringList &visited,
-                                 bool dashFallback) const
+XdgIconInfo XdgIconLoader::findIconHelper(const QString &themeName,
+                                 const QStringList &iconNames,
+                                 bool dashFallback,
+                                 qsizetype *found) const
 {
-    QThemeIconInfo info;
     Q_ASSERT(!themeName.isEmpty());
 
-    // Used to protect against potential recursions
-    visited << themeName;
+    const QList<XdgIconDirRecord> order = searchOrder(themeName);
 
-    XdgIconTheme &theme = themeList[themeName];
-    if (!theme.isValid()) {
-        theme = XdgIconTheme(themeName);
-        if (!theme.isValid()) {
-            const QString fallback = fallbackTheme();
-            if (!fallback.isEmpty())
-                theme = XdgIconTheme(fallback);
+    // All the names to look for, with their dash fallbacks, from the most
+    // wanted one to the least. The names are searched in one pass over the
+    // directories, keeping the most wanted match. Their dash fallbacks only
+    // in a second pass, if a name before the match wasn't found at all.
+    struct Candidate
+    {
+        QString name;
+        qsizetype index;
+        bool isFallback;
+        QString pngName;
+        QString svgName;
+        QString xpmName;
+    };
+    QList<Candidate> candidates;
+    for (qsizetype i = 0; i < iconNames.size(); ++i) {
+        QStringView name(iconNames.at(i));
+        bool isFallback = false;
+        while (!name.isEmpty()) {
+            candidates.append({name.toString(), i, isFallback, name + ".png"_L1, name + ".svg"_L1, name + ".xpm"_L1});
+            const qsizetype indexOfDash = dashFallback ? name.lastIndexOf(u'-') : -1;
+            if (indexOfDash == -1)
+                break;
+            name.truncate(indexOfDash);
+            isFallback = true;
         }
     }
 
-    const QStringList contentDirs = theme.contentDirs();
-
-    const QString svgext(".svg"_L1);
-    const QString pngext(".png"_L1);
-    const QString xpmext(".xpm"_L1);
-
-
-    QStringView iconNameFallback(iconName);
+    const qsizetype count = candidates.size();
+    QList<XdgIconInfo> infos(count);
+    // The theme each candidate was found in, its files are only taken from
+    // that one
+    QList<int> foundThemes(count, -1);
+    qsizetype best = count;
+
+    auto search = [&](bool fallbacks, qsizetype first) {
+        for (const XdgIconDirRecord &record : order) {
+            // Nothing can beat the first wanted candidate once its theme is done
+            if (best <= first && record.theme != foundThemes.at(best))
+                break;
 
-    // Iterate through all icon's fallbacks in current theme
-    if (info.entries.empty()) {
-        const QString svgIconName = iconNameFallback + svgext;
-        const QString pngIconName = iconNameFallback + pngext;
-        const QString xpmIconName = iconNameFallback + xpmext;
-
-        // Add all relevant files
-        for (int i = 0; i < contentDirs.size(); ++i) {
-            QList<QIconDirInfo> subDirs = theme.keyList();
-
-            // Try to reduce the amount of subDirs by looking in the GTK+ cache in order to save
-            // a massive amount of file stat (especially if the icon is not there)
-            auto cache = theme.m_gtkCaches.at(i);
-            if (cache->isValid() || cache->reValid(true)) {
-                const auto result = cache->lookup(iconNameFallback);
-                if (cache->isValid()) {
-                    const QList<QIconDirInfo> subDirsCopy = subDirs;
-                    subDirs.clear();
-                    subDirs.reserve(result.count());
-                    for (const char *s : result) {
-                        QString path = QString::fromUtf8(s);
-                        auto it = std::find_if(subDirsCopy.cbegin(), subDirsCopy.cend(),
-                                               [&](const QIconDirInfo &info) {
-                                                   return info.path == path; } );
-                        if (it != subDirsCopy.cend()) {
-                            subDirs.append(*it);
-                        }
+            const XdgIconEntryInfo::Kind scalableKind = followColorScheme() && record.followsColorScheme
+                ? XdgIconEntryInfo::ScalableFollowsColor
+                : XdgIconEntryInfo::Scalable;
+
+            QList<QIconDirInfo> subDirs;
+            for (qsizetype c = first; c < count && c <= best; ++c) {
+                const Candidate &candidate = candidates.at(c);
+                if (candidate.isFallback != fallbacks)
+                    continue;
+                if (foundThemes.at(c) != -1 && foundThemes.at(c) != record.theme)
+                    continue;
+                XdgIconInfo &info = infos[c];
+
+                // Try to reduce the amount of subDirs by looking in the GTK+ cache in order to save
+                // a massive amount of file stat (especially if the icon is not there)
+                if (!record.gtkCache->findSubDirs(candidate.name, record.dirs, &subDirs))
+                    subDirs = record.dirs;
+
+                for (int j = 0; j < subDirs.size() ; ++j) {
+                    const QIconDirInfo &dirInfo = subDirs.at(j);
+                    const QString subDir = record.path + dirInfo.path + u'/';
+                    const QString pngPath = subDir + candidate.pngName;
+                    if (QFile::exists(pngPath)) {
+                        addEntry(info, XdgIconEntryInfo::Pixmap, pngPath, dirInfo);
+                    } else if (gSupportsSvg) {
+                        const QString svgPath = subDir + candidate.svgName;
+                        if (QFile::exists(svgPath))
+                            addEntry(info, scalableKind, svgPath, dirInfo);
                     }
+                    const QString xpmPath = subDir + candidate.xpmName;
+                    if (QFile::exists(xpmPath))
+                        addEntry(info, XdgIconEntryInfo::Pixmap, xpmPath, dirInfo);
                 }
-            }
 
-            QString contentDir = contentDirs.at(i) + u'/';
-            for (int j = 0; j < subDirs.size() ; ++j) {
-                const QIconDirInfo &dirInfo = subDirs.at(j);
-                const QString subDir = contentDir + dirInfo.path + u'/';
-                const QString pngPath = subDir + pngIconName;
-                if (QFile::exists(pngPath)) {
-                    auto iconEntry = std::make_unique<PixmapEntry>();
-                    iconEntry->dir = dirInfo;
-                    iconEntry->filename = pngPath;
-                    // Notice we ensure that pixmap entries always come before
-                    // scalable to preserve search order afterwards
-                    info.entries.insert(info.entries.begin(), std::move(iconEntry));
-                } else if (gSupportsSvg) {
-                    const QString svgPath = subDir + svgIconName;
-                    if (QFile::exists(svgPath)) {
-                        std::unique_ptr<QIconLoaderEngineEntry> iconEntry;
-                        if (followColorScheme() && theme.followsColorScheme())
-                            iconEntry.reset(new ScalableFollowsColorEntry);
-                        else
-                            iconEntry.reset(new ScalableEntry);
-                        iconEntry->dir = dirInfo;
-                        iconEntry->filename = svgPath;
-                        info.entries.push_back(std::move(iconEntry));
-                    }
+                if (foundThemes.at(c) == -1 && !info.entries.empty()) {
+                    foundThemes[c] = record.theme;
+                    best = c;
                 }
-                const QString xpmPath = subDir + xpmIconName;
-                if (QFile::exists(xpmPath)) {
-                    auto iconEntry = std::make_unique<PixmapEntry>();
-                    iconEntry->dir = dirInfo;
-                    iconEntry->filename = xpmPath;
-                    // Notice we ensure that pixmap entries always come before
-                    // scalable to preserve search order afterwards
-                    info.entries.insert(info.entries.begin(), std::move(iconEntry));
+            }
+        }
+    };
+
+    search(false, 0);
+    // Most lookups end here, the specific name is usually there
+    qsizetype firstFallback = 0;
+    while (firstFallback < best && !candidates.at(firstFallback).isFallback)
+        ++firstFallback;
+    if (firstFallback < best)
+        search(true, firstFallback);
+
+    // Also, consider Qt's fallback search paths (which are not defined by Freedesktop)
+    // if a more wanted candidate is not found in any inherited theme
+    QStringList fallbackPaths;
+    {
+        QReadLocker locker(&m_lock);
+        fallbackPaths = m_fallbackSearchPaths;
+    }
+    for (qsizetype c = 0; c < count; ++c) {
+        const Candidate &candidate = candidates.at(c);
+        XdgIconInfo &info = infos[c];
+        if (c < best) {
+            for (const auto &fallbackPath : fallbackPaths) {
+                const QString pngPath = fallbackPath + u'/' + candidate.pngName;
+                if (QFile::exists(pngPath)) {
+                    addEntry(info, XdgIconEntryInfo::Pixmap, pngPath, QIconDirInfo(fallbackPath));
+                } else {
+                    const QString svgPath = fallbackPath + u'/' + candidate.svgName;
+                    if (gSupportsSvg && QFile::exists(svgPath))
+                        addEntry(info, XdgIconEntryInfo::Scalable, svgPath, QIconDirInfo(fallbackPath));
                 }
             }
         }
 
-        if (!info.entries.empty())
-            info.iconName = iconNameFallback.toString();
+        if (!info.entries.empty()) {
+            info.iconName = candidate.name;
+            // The most wanted name can only be shadowed by the themes
+            // searched before its own
+            if (c == 0 && foundThemes.at(0) != -1) {
+                info.searchDepth = 0;
+                while (info.searchDepth < order.size() && order.at(info.searchDepth).theme <= foundThemes.at(0))
+                    ++info.searchDepth;
+            }
+            if (found)
+                *found = candidate.index;
+            return info;
+        }
     }
 
-    if (info.entries.empty()) {
-        const QStringList parents = theme.parents();
-        // Search recursively through inherited themes
-        for (int i = 0 ; i < parents.size() ; ++i) {
-
-            const QString parentTheme = parents.at(i).trimmed();
-
-            if (!visited.contains(parentTheme)) // guard against recursion
-                info = findIconHelper(parentTheme, iconName, visited);
-
-            if (!info.entries.empty()) // success
-                break;
-        }
+    if (found)
+        *found = -1;
+    return XdgIconInfo();
+}
 
-        // make sure that hicolor is also searched before dash fallbacks
-        if (info.entries.empty()
-            && !parents.contains("hicolor"_L1)
-            && !visited.contains("hicolor"_L1)) {
-            info = findIconHelper("hicolor"_L1, iconName, visited);
-        }
+/*
+ * The directories of the theme and of the themes it inherits, in the order
+ * of the icon lookups. Built once per theme.
+ */
+QList<XdgIconDirRecord> XdgIconLoader::searchOrder(const QString &themeName) const
+{
+    {
+        QReadLocker locker(&m_lock);
+        const auto it = m_searchOrders.constFind(themeName);
+        if (it != m_searchOrders.constEnd())
+            return *it;
     }
 
-    if (info.entries.empty()) {
-        // Also, consider Qt's fallback search paths (which are not defined by Freedesktop)
-        // if the icon is not found in any inherited theme
-        const auto fallbackPaths = QIcon::fallbackSearchPaths();
-        for (const auto &fallbackPath : fallbackPaths) {
-            const QString pngPath = fallbackPath + u'/' + iconName + pngext;
-            if (QFile::exists(pngPath)) {
-                auto iconEntry = std::make_unique<PixmapEntry>();
-                QIconDirInfo dirInfo(fallbackPath);
-                iconEntry->dir = dirInfo;
-                iconEntry->filename = pngPath;
-                info.entries.insert(info.entries.begin(), std::move(iconEntry));
-            } else {
-                const QString svgPath = fallbackPath + u'/' + iconName + svgext;
-                if (gSupportsSvg && QFile::exists(svgPath)) {
-                    auto iconEntry = std::make_unique<ScalableEntry>();
-                    QIconDirInfo dirInfo(fallbackPath);
-                    iconEntry->dir = dirInfo;
-                    iconEntry->filename = svgPath;
-                    info.entries.push_back(std::move(iconEntry));
-                }
-            }
-        }
+    QList<XdgIconDirRecord> order;
+    // Used to protect against potential recursions
+    QStringList visited;
+    appendSearchOrder(themeName, order, visited);
+    // make sure that hicolor is also searched before dash fallbacks
+    if (!visited.contains("hicolor"_L1))
+        appendSearchOrder("hicolor"_L1, order, visited);
+
+    // A theme that isn't installed yet is looked for again next time
+    if (findTheme(themeName).isValid()) {
+        QWriteLocker locker(&m_lock);
+        m_searchOrders.insert(themeName, order);
     }
+    return order;
+}
 
-    if (dashFallback && info.entries.empty()) {
-        // If it's possible - find next fallback for the icon
-        const int indexOfDash = iconNameFallback.lastIndexOf(u'-');
-        if (indexOfDash != -1) {
-            iconNameFallback.truncate(indexOfDash);
-            QStringList _visited;
-            info = findIconHelper(themeName, iconNameFallback.toString(), _visited, true);
-        }
+void XdgIconLoader::appendSearchOrder(const QString &themeName, QList<XdgIconDirRecord> &order,
+                                      QStringList &visited) const
+{
+    visited << themeName;
+
+    const XdgIconTheme theme = findTheme(themeName);
+    const QStringList contentDirs = theme.contentDirs();
+    const int themeIndex = visited.size() - 1;
+    for (int i = 0; i < contentDirs.size(); ++i) {
+        XdgIconDirRecord record;
+        record.path = contentDirs.at(i) + u'/';
+        record.gtkCache = theme.m_gtkCaches.at(i);
+        record.dirs = theme.keyList();
+        record.theme = themeIndex;
+        record.followsColorScheme = theme.followsColorScheme();
+        order.append(record);
     }
 
-    return info;
+    // Search recursively through inherited themes
+    const QStringList parents = theme.parents();
+    for (const QString &parent : parents) {
+        const QString parentTheme = parent.trimmed();
+        if (!visited.contains(parentTheme)) // guard against recursion
+            appendSearchOrder(parentTheme, order, visited);
+    }
 }
 
-QThemeIconInfo XdgIconLoader::unthemedFallback(const QString &iconName, const QStringList &searchPaths) const
+XdgIconInfo XdgIconLoader::unthemedFallback(const QString &iconName, const QStringList &searchPaths) const
 {
-    QThemeIconInfo info;
+    XdgIconInfo info;
 
     const QString svgext(".svg"_L1);
     const QString pngext(".png"_L1);
@@ -541,101 +1016,370 @@ QThemeIconInfo XdgIconLoader::unthemedFallback(const QString &iconName, const QS
         QDir currentDir(contentDir);
 
         if (currentDir.exists(iconName + pngext)) {
-            auto iconEntry = std::make_unique<PixmapEntry>();
-            iconEntry->filename = currentDir.filePath(iconName + pngext);
-            // Notice we ensure that pixmap entries always come before
-            // scalable to preserve search order afterwards
-            info.entries.insert(info.entries.begin(), std::move(iconEntry));
+            addEntry(info, XdgIconEntryInfo::Pixmap, currentDir.filePath(iconName + pngext));
         } else if (gSupportsSvg &&
             currentDir.exists(iconName + svgext)) {
-            auto iconEntry = std::make_unique<ScalableEntry>();
-            iconEntry->filename = currentDir.filePath(iconName + svgext);
-            info.entries.push_back(std::move(iconEntry));
+            addEntry(info, XdgIconEntryInfo::Scalable, currentDir.filePath(iconName + svgext));
         } else if (currentDir.exists(iconName + xpmext)) {
-            auto iconEntry = std::make_unique<PixmapEntry>();
-            iconEntry->filename = currentDir.filePath(iconName + xpmext);
-            // Notice we ensure that pixmap entries always come before
-            // scalable to preserve search order afterwards
-            info.entries.insert(info.entries.begin(), std::move(iconEntry));
+            addEntry(info, XdgIconEntryInfo::Pixmap, currentDir.filePath(iconName + xpmext));
         }
     }
     return info;
 }
 
-QThemeIconInfo XdgIconLoader::loadIcon(const QString &name) const
+/*
+ * QIconLoader and QIcon's search paths aren't thread-safe, so they must only
+ * be asked on the GUI thread. The other threads get the theme and the paths
+ * reported the last time they were asked, so a theme change is seen by them
+ * once the GUI thread resolved an icon. The resolved icons are dropped when
+ * the theme (or its search paths) changed, the parsed themes when the paths
+ * did.
+ */
+void XdgIconLoader::currentTheme(QString *themeName, uint *key) const
 {
-    const QString theme_name = QIconLoader::instance()->themeName();
-    if (!theme_name.isEmpty()) {
-        QStringList visited;
-        auto info = findIconHelper(theme_name, name, visited, true);
-        if (info.entries.empty()) {
-            auto unthemedInfo = unthemedFallback(name, QIcon::themeSearchPaths());
-            if (unthemedInfo.entries.empty()) {
-                /* Freedesktop standard says to look in /usr/share/pixmaps last */
-                const QStringList pixmapPath = (QStringList() << "/usr/share/pixmaps"_L1);
-                auto pixmapInfo = unthemedFallback(name, pixmapPath);
-                if (pixmapInfo.entries.empty()) {
-                    return QThemeIconInfo();
-                } else {
-                    return pixmapInfo;
-                }
-            } else {
-                return unthemedInfo;
+    if (isGuiThread()) {
+        *themeName = QIconLoader::instance()->themeName();
+        *key = QIconLoader::instance()->themeKey();
+        {
+            QReadLocker locker(&m_lock);
+            if (m_resolvedKey == *key)
+                return;
+        }
+        const QStringList themeSearchPaths = QIcon::themeSearchPaths();
+        const QStringList fallbackSearchPaths = QIcon::fallbackSearchPaths();
+        QWriteLocker locker(&m_lock);
+        if (m_resolvedKey != *key) {
+            m_resolved.clear();
+            m_resolvedKey = *key;
+            m_themeName = *themeName;
+            if (m_themeSearchPaths != themeSearchPaths) {
+                themeList.clear();
+                m_searchOrders.clear();
+                m_themeSearchPaths = themeSearchPaths;
             }
-        } else {
-            return info;
+            m_fallbackSearchPaths = fallbackSearchPaths;
         }
+        return;
     }
 
-    return QThemeIconInfo();
+    QReadLocker locker(&m_lock);
+    *themeName = m_themeName;
+    *key = m_resolvedKey;
 }
 
-
-// -------- Icon Loader Engine -------- //
-
-
-XdgIconLoaderEngine::XdgIconLoaderEngine(const QString& iconName)
-        : m_iconName(iconName), m_key(0)
+// The resolved icon of name, nullptr if it must be searched. m_lock must be
+// held for writing.
+const XdgIconInfo *XdgIconLoader::cachedIcon(const QString &name) const
 {
+    const XdgIconInfo *info = m_resolved.object(name);
+    if (info && info->entries.empty() && info->generation != m_generation)
+        return nullptr;
+    return info;
 }
 
-XdgIconLoaderEngine::~XdgIconLoaderEngine() = default;
-
-XdgIconLoaderEngine::XdgIconLoaderEngine(const XdgIconLoaderEngine &other)
-        : QIconEngine(other),
-        m_iconName(other.m_iconName),
-        m_key(0)
+qsizetype XdgIconLoader::engineCost(const QString &iconName, bool *resolved) const
 {
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+
+    qsizetype cost = sizeof(XdgIconLoaderEngine) + iconName.size() * qsizetype(sizeof(QChar));
+    QWriteLocker locker(&m_lock);
+    const XdgIconInfo *info = m_resolvedKey == key ? cachedIcon(iconName) : nullptr;
+    *resolved = info != nullptr;
+    if (!info)
+        return cost;
+    for (const XdgIconEntryInfo &entry : info->entries) {
+        switch (entry.kind) {
+        case XdgIconEntryInfo::Pixmap:
+            cost += sizeof(XdgPixmapEntry);
+            break;
+        case XdgIconEntryInfo::Scalable:
+            cost += sizeof(XdgScalableEntry);
+            break;
+        case XdgIconEntryInfo::ScalableFollowsColor:
+            cost += sizeof(ScalableFollowsColorEntry);
+            break;
+        }
+        cost += sizeof(XdgIconEntryInfo::Kind) + entry.filename.size() * qsizetype(sizeof(QChar));
+    }
+    return cost;
 }
 
-QIconEngine *XdgIconLoaderEngine::clone() const
+XdgIconInfo XdgIconLoader::resolveIcon(const QString &name, const QString &themeName, uint key) const
 {
-    return new XdgIconLoaderEngine(*this);
-}
+    const uint generation = m_generation;
+    {
+        QWriteLocker locker(&m_lock);
+        if (m_resolvedKey == key) {
+            if (const XdgIconInfo *cached = cachedIcon(name))
+                return *cached;
+        }
+    }
 
-bool XdgIconLoaderEngine::read(QDataStream &in) {
-    in >> m_iconName;
-    return true;
+    XdgIconInfo info;
+    if (!themeName.isEmpty()) {
+        info = findIconHelper(themeName, QStringList(name), true);
+        if (info.entries.empty())
+            info = unthemedIcon(name);
+    }
+    info.generation = generation;
+
+    QWriteLocker locker(&m_lock);
+    // Don't pollute the cache with the results of an outdated theme
+    if (m_resolvedKey == key && m_generation == generation)
+        m_resolved.insert(name, new XdgIconInfo(info));
+    return info;
 }
 
-bool XdgIconLoaderEngine::write(QDataStream &out) const
+XdgIconInfo XdgIconLoader::unthemedIcon(const QString &iconName) const
 {
-    out << m_iconName;
-    return true;
+    QStringList searchPaths;
+    {
+        QReadLocker locker(&m_lock);
+        searchPaths = m_themeSearchPaths;
+    }
+    XdgIconInfo info = unthemedFallback(iconName, searchPaths);
+    if (info.entries.empty()) {
+        /* Freedesktop standard says to look in /usr/share/pixmaps last */
+        const QStringList pixmapPath = (QStringList() << "/usr/share/pixmaps"_L1);
+        info = unthemedFallback(iconName, pixmapPath);
+    }
+    return info;
 }
 
-bool XdgIconLoaderEngine::hasIcon() const
+qsizetype XdgIconLoader::resolveFirst(const QStringList &iconNames) const
 {
-    return !(m_info.entries.empty());
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+    const uint generation = m_generation;
+
+    // Names resolved already don't need to be searched again
+    qsizetype first = 0;
+    {
+        QWriteLocker locker(&m_lock);
+        if (m_resolvedKey == key) {
+            for (; first < iconNames.size(); ++first) {
+                const XdgIconInfo *cached = cachedIcon(iconNames.at(first));
+                if (!cached)
+                    break;
+                if (!cached->entries.empty())
+                    return first;
+            }
+        }
+    }
+    if (first == iconNames.size() || themeName.isEmpty())
+        return -1;
+
+    const QStringList remaining = iconNames.mid(first);
+    qsizetype found = -1;
+    XdgIconInfo info = findIconHelper(themeName, remaining, true, &found);
+
+    // The unthemed icons of the names before the one found still come first
+    const qsizetype unthemedCount = found == -1 ? remaining.size() : found;
+    for (qsizetype i = 0; i < unthemedCount; ++i) {
+        XdgIconInfo unthemed = unthemedIcon(remaining.at(i));
+        if (!unthemed.entries.empty()) {
+            found = i;
+            info = std::move(unthemed);
+            break;
+        }
+    }
+
+    info.generation = generation;
+
+    QWriteLocker locker(&m_lock);
+    // Don't pollute the cache with the results of an outdated theme
+    if (m_resolvedKey == key && m_generation == generation) {
+        const qsizetype missing = found == -1 ? remaining.size() : found;
+        for (qsizetype i = 0; i < missing; ++i) {
+            XdgIconInfo *empty = new XdgIconInfo;
+            empty->generation = generation;
+            m_resolved.insert(remaining.at(i), empty);
+        }
+        if (found != -1)
+            m_resolved.insert(remaining.at(found), new XdgIconInfo(info));
+    }
+    return found == -1 ? -1 : first + found;
 }
 
-// Lazily load the icon
-void XdgIconLoaderEngine::ensureLoaded()
+QThemeIconInfo XdgIconLoader::loadIcon(const QString &name) const
 {
-    if (QIconLoader::instance()->themeKey() != m_key) {
-        m_info = XdgIconLoader::instance()->loadIcon(m_iconName);
-        m_key = QIconLoader::instance()->themeKey();
-    }
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+    return createThemeIconInfo(resolveIcon(name, themeName, key));
+}
+
+namespace {
+// Renders the prewarmed icons on the GUI thread, a few at a time, so that
+// the event loop keeps running
+class PrewarmRenderer : public QObject
+{
+public:
+    PrewarmRenderer(const QStringList &iconNames, const QList<int> &sizes, uint key)
+        : m_iconNames(iconNames)
+        , m_sizes(sizes)
+        , m_key(key)
+    {
+    }
+
+    void renderNext()
+    {
+        // Rendering with an outdated theme is a waste of time
+        if (m_key != QIconLoader::instance()->themeKey() || m_next >= m_iconNames.size()) {
+            deleteLater();
+            return;
+        }
+
+        const qreal dpr = qApp->devicePixelRatio();
+        const int last = std::min(m_next + 16, int(m_iconNames.size()));
+        for (; m_next < last; ++m_next) {
+            const QIcon icon(new XdgIconLoaderEngine(m_iconNames.at(m_next)));
+            for (const int size : std::as_const(m_sizes))
+                icon.pixmap(QSize(size, size), dpr);
+        }
+        QMetaObject::invokeMethod(this, &PrewarmRenderer::renderNext, Qt::QueuedConnection);
+    }
+
+private:
+    const QStringList m_iconNames;
+    const QList<int> m_sizes;
+    const uint m_key;
+    int m_next = 0;
+};
+}
+
+XdgIconLoader::XdgIconLoader()
+{
+    // Prewarming is background work, don't let it compete with itself
+    m_prewarmPool.setMaxThreadCount(1);
+}
+
+void XdgIconLoader::prewarm(const QStringList &iconNames, const QList<int> &sizes)
+{
+    if (iconNames.isEmpty())
+        return;
+
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+
+    m_prewarmPool.start([this, iconNames, sizes, themeName, key] {
+        for (const QString &iconName : iconNames) {
+            if (!iconName.isEmpty())
+                resolveIcon(iconName, themeName, key);
+        }
+
+        if (sizes.isEmpty() || !qApp)
+            return;
+        auto renderer = new PrewarmRenderer(iconNames, sizes, key);
+        renderer->moveToThread(qApp->thread());
+        QMetaObject::invokeMethod(renderer, &PrewarmRenderer::renderNext, Qt::QueuedConnection);
+    });
+}
+
+
+void XdgIconLoader::resolve(const QStringList &iconNames) const
+{
+    if (iconNames.isEmpty())
+        return;
+
+    QString themeName;
+    uint key;
+    currentTheme(&themeName, &key);
+
+    // Every thread takes the next unresolved name until none is left
+    std::atomic<qsizetype> next{0};
+    const auto work = [&] {
+        for (qsizetype i = next++; i < iconNames.size(); i = next++) {
+            if (!iconNames.at(i).isEmpty())
+                resolveIcon(iconNames.at(i), themeName, key);
+        }
+    };
+
+    // Only idle threads of the global pool help, the calling thread does
+    // its share anyway, so that a busy pool can't stall it
+    QThreadPool *pool = QThreadPool::globalInstance();
+    const qsizetype helpers = std::min<qsizetype>(pool->maxThreadCount(), iconNames.size() / 16);
+    QSemaphore done;
+    int started = 0;
+    for (qsizetype i = 0; i < helpers; ++i) {
+        if (!pool->tryStart([&work, &done] { work(); done.release(); }))
+            break;
+        ++started;
+    }
+    work();
+    done.acquire(started);
+}
+
+
+// -------- Icon Loader Engine -------- //
+
+
+XdgIconLoaderEngine::XdgIconLoaderEngine(const QString& iconName)
+        : m_iconName(iconName), m_key(0)
+{
+}
+
+XdgIconLoaderEngine::~XdgIconLoaderEngine() = default;
+
+XdgIconLoaderEngine::XdgIconLoaderEngine(const XdgIconLoaderEngine &other)
+        : QIconEngine(other),
+        m_iconName(other.m_iconName),
+        m_key(0)
+{
+}
+
+QIconEngine *XdgIconLoaderEngine::clone() const
+{
+    return new XdgIconLoaderEngine(*this);
+}
+
+bool XdgIconLoaderEngine::read(QDataStream &in) {
+    in >> m_iconName;
+    return true;
+}
+
+bool XdgIconLoaderEngine::write(QDataStream &out) const
+{
+    out << m_iconName;
+    return true;
+}
+
+bool XdgIconLoaderEngine::hasIcon() const
+{
+    return !(m_info.entries.empty());
+}
+
+// Lazily load the icon, m_mutex must be held
+void XdgIconLoaderEngine::ensureLoaded()
+{
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    const uint generation = loader->generation();
+    QString themeName;
+    uint key;
+    // Not QIconLoader's key, m_info must match the theme it's resolved in
+    loader->currentTheme(&themeName, &key);
+    const bool themeChanged = key != m_key;
+    if (!themeChanged && generation == m_generation)
+        return;
+
+    const XdgIconInfo info = loader->resolveIcon(m_iconName, themeName, key);
+    m_generation = generation;
+    // Some other icons were invalidated, this one is resolved already
+    if (!themeChanged && info.generation == m_infoGeneration)
+        return;
+
+    m_info = createThemeIconInfo(info);
+    m_kinds.clear();
+    m_kinds.reserve(info.entries.size());
+    for (const XdgIconEntryInfo &entry : info.entries)
+        m_kinds.append(entry.kind);
+    m_entryForSize.clear();
+    m_infoGeneration = info.generation;
+    m_key = key;
 }
 
 void XdgIconLoaderEngine::paint(QPainter *painter, const QRect &rect,
@@ -728,6 +1472,29 @@ QIconLoaderEngineEntry *XdgIconLoaderEngine::entryForSize(const QThemeIconInfo &
     return closestMatch;
 }
 
+// Memoized entryForSize(), views ask for the same few sizes over and over.
+// m_mutex must be held.
+qsizetype XdgIconLoaderEngine::entryIndexForSize(const QSize &size, int scale)
+{
+    const int iconsize = std::min(size.width(), size.height());
+    const quint64 key = (quint64(quint32(iconsize)) << 32) | quint32(scale);
+    const auto it = m_entryForSize.constFind(key);
+    if (it != m_entryForSize.constEnd())
+        return *it;
+
+    // Only the smaller side matters, so the size is passed as a square
+    qsizetype index = -1;
+    if (QIconLoaderEngineEntry *entry = entryForSize(m_info, QSize(iconsize, iconsize), scale)) {
+        for (index = 0; m_info.entries[index].get() != entry; ++index)
+            ;
+    }
+    // Sizes requested by views are few, this is only a safety net
+    if (m_entryForSize.size() >= 64)
+        m_entryForSize.clear();
+    m_entryForSize.insert(key, index);
+    return index;
+}
+
 /*
  * Returns the actual icon size. For scalable svg's this is equivalent
  * to the requested size. Otherwise the closest match is returned but
@@ -740,24 +1507,24 @@ QSize XdgIconLoaderEngine::actualSize(const QSize &size, QIcon::Mode mode,
     Q_UNUSED(mode);
     Q_UNUSED(state);
 
+    QMutexLocker locker(&m_mutex);
     ensureLoaded();
 
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size);
-    if (entry) {
+    const qsizetype index = entryIndexForSize(size, 1);
+    if (index >= 0) {
+        QIconLoaderEngineEntry *entry = m_info.entries[index].get();
         const QIconDirInfo &dir = entry->dir;
         if (dir.type == QIconDirInfo::Scalable
-            || dynamic_cast<ScalableEntry *>(entry)
-            || dynamic_cast<ScalableFollowsColorEntry *>(entry)) {
+            || m_kinds.at(index) != XdgIconEntryInfo::Pixmap) {
             return size;
         }
         else {
             int dir_size = dir.size;
             //Note: fallback for directories that don't have its content size defined
             //  -> get the actual size based on the image if possible
-            PixmapEntry * pix_e;
-            if (0 == dir_size && nullptr != (pix_e = dynamic_cast<PixmapEntry *>(entry)))
+            if (0 == dir_size)
             {
-                QSize pix_size = pix_e->basePixmap.size();
+                QSize pix_size = static_cast<XdgPixmapEntry *>(entry)->baseSize();
                 dir_size = std::min(pix_size.width(), pix_size.height());
             }
             int result = std::min(dir_size, std::min(size.width(), size.height()));
@@ -767,19 +1534,650 @@ QSize XdgIconLoaderEngine::actualSize(const QSize &size, QIcon::Mode mode,
     return {0, 0};
 }
 
-// XXX: duplicated from qiconloader.cpp, because this symbol isn't exported :(
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
-#else
-QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
-#endif
+// Applies the style of the mode (e.g. the grayed out disabled look) to a
+// pixmap, like QPixmapIconEngine does
+static QPixmap applyIconStyle(QIcon::Mode mode, const QPixmap &pixmap)
 {
-    Q_UNUSED(state);
+    if (mode == QIcon::Normal)
+        return pixmap;
+    if (QGuiApplication *guiApp = qobject_cast<QGuiApplication *>(qApp))
+        return static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))->applyQIconStyleHelper(mode, pixmap);
+    return pixmap;
+}
+
+/*
+ * Parsed SVG documents of the scalable entries, shared by all the engines.
+ * Parsing the file is the expensive part of rendering an SVG icon, so the
+ * renderers are kept around for the next size, mode or scale. The least
+ * recently used ones are evicted when the budget is exceeded. The cost of a
+ * document is the size of its source, the parsed tree is roughly
+ * proportional to it.
+ *
+ * Icons following the color scheme are split once into a template around
+ * the contents of their "current-color-scheme" style element. Recoloring
+ * them is then a matter of concatenating the template with the style sheet
+ * of the palette. Their renderers depend on the palette and are the only
+ * ones dropped when it changes.
+ *
+ * Only used on the GUI thread, like QPixmapCache.
+ */
+class SvgRendererCache
+{
+public:
+    bool render(const QString &filename, QPainter *painter, const QRectF &bounds);
+    bool renderRecolored(const QString &filename, const QString &styleSheet,
+                         QPainter *painter, const QRectF &bounds);
+    int limit() const { return int(m_documents.maxCost() / 1024); }
+    void setLimit(int kb) { m_documents.setMaxCost(qsizetype(kb) * 1024); }
+    void removeFiles(const QString &dir);
+
+private:
+    struct Key
+    {
+        QString filename;
+        // The style sheet the renderer was recolored with, if any
+        QString styleSheet;
+        bool isTemplate = false;
+
+        friend bool operator==(const Key &a, const Key &b)
+        {
+            return a.isTemplate == b.isTemplate && a.filename == b.filename && a.styleSheet == b.styleSheet;
+        }
+        friend size_t qHash(const Key &key, size_t seed = 0)
+        {
+            return qHashMulti(seed, key.filename, key.styleSheet, key.isTemplate);
+        }
+    };
+
+    struct Document
+    {
+        std::unique_ptr<QSvgRenderer> renderer;
+        // The recoloring template: the source up to the contents of the
+        // style element, the contents and the rest of it
+        QString head;
+        QString style;
+        QString tail;
+        bool hasStyle = false;
+    };
+
+    void checkKeys();
+    void insert(const Key &key, Document *document, qsizetype cost);
+    // Owned by the cache, or by uncached when it's too big to be kept
+    const Document *recolorTemplate(const QString &filename, std::unique_ptr<Document> *uncached);
+
+    QCache<Key, Document> m_documents{4 * 1024 * 1024};
+    uint m_key = 0;
+    qint64 m_paletteKey = 0;
+};
+Q_GLOBAL_STATIC(SvgRendererCache, svgRendererCache)
+
+void SvgRendererCache::checkKeys()
+{
+    // The files may have changed along with the theme
+    const uint key = XdgIconLoader::instance()->themeKey();
+    if (m_key != key) {
+        m_documents.clear();
+        m_key = key;
+    }
+
+    const qint64 paletteKey = QGuiApplication::palette().cacheKey();
+    if (m_paletteKey != paletteKey) {
+        const QList<Key> keys = m_documents.keys();
+        for (const Key &documentKey : keys) {
+            if (!documentKey.styleSheet.isEmpty())
+                m_documents.remove(documentKey);
+        }
+        m_paletteKey = paletteKey;
+    }
+}
+
+void SvgRendererCache::insert(const Key &key, Document *document, qsizetype cost)
+{
+    // QCache would delete a document that doesn't fit at once
+    if (cost <= m_documents.maxCost())
+        m_documents.insert(key, document, std::max(cost, qsizetype(1)));
+    else
+        delete document;
+}
+
+bool SvgRendererCache::render(const QString &filename, QPainter *painter, const QRectF &bounds)
+{
+    checkKeys();
+
+    const Key key{filename, QString(), false};
+    if (Document *document = m_documents.object(key)) {
+        document->renderer->render(painter, bounds);
+        return true;
+    }
+
+    auto document = std::make_unique<Document>();
+    document->renderer = std::make_unique<QSvgRenderer>();
+    if (!document->renderer->load(filename))
+        return false;
+    document->renderer->render(painter, bounds);
+    insert(key, document.release(), QFileInfo(filename).size());
+    return true;
+}
+
+const SvgRendererCache::Document *SvgRendererCache::recolorTemplate(const QString &filename,
+                                                                   std::unique_ptr<Document> *uncached)
+{
+    const Key key{filename, QString(), true};
+    if (Document *document = m_documents.object(key))
+        return document;
+
+    QFile device{filename};
+    if (!device.open(QIODevice::ReadOnly))
+        return nullptr;
+
+    auto document = std::make_unique<Document>();
+    const QString source = QString::fromUtf8(device.readAll());
+    QXmlStreamReader xmlReader(source);
+    while (!xmlReader.atEnd())
+    {
+        if (xmlReader.readNext() == QXmlStreamReader::StartElement
+            && xmlReader.qualifiedName() == "style"_L1
+            && xmlReader.attributes().value("id"_L1) == "current-color-scheme"_L1)
+        {
+            // The reader is right after the start tag, the contents end
+            // where the end tag starts
+            const qsizetype contentsStart = xmlReader.characterOffset();
+            qsizetype contentsEnd = contentsStart;
+            while (xmlReader.readNext() != QXmlStreamReader::EndElement && !xmlReader.atEnd())
+                contentsEnd = xmlReader.characterOffset();
+            if (xmlReader.hasError())
+                break;
+
+            if (contentsStart >= 2 && QStringView(source).mid(contentsStart - 2, 2) == "/>"_L1) {
+                // An empty element, <style id="current-color-scheme"/>
+                document->head = source.left(contentsStart - 2) + u'>';
+                document->tail = "</style>"_L1 + QStringView(source).mid(contentsStart);
+            } else {
+                document->head = source.left(contentsStart);
+                document->style = source.mid(contentsStart, contentsEnd - contentsStart);
+                document->tail = source.mid(contentsEnd);
+            }
+            document->hasStyle = true;
+            break;
+        }
+    }
+
+    const qsizetype cost = (document->head.size() + document->style.size()
+                            + document->tail.size()) * qsizetype(sizeof(QChar));
+    if (cost > m_documents.maxCost()) {
+        // Still recolored, just parsed again next time
+        *uncached = std::move(document);
+        return uncached->get();
+    }
+    const Document *recolorTemplate = document.get();
+    insert(key, document.release(), cost);
+    return recolorTemplate;
+}
+
+bool SvgRendererCache::renderRecolored(const QString &filename, const QString &styleSheet,
+                                       QPainter *painter, const QRectF &bounds)
+{
+    checkKeys();
+
+    const Key key{filename, styleSheet, false};
+    if (Document *document = m_documents.object(key)) {
+        document->renderer->render(painter, bounds);
+        return true;
+    }
+
+    std::unique_ptr<Document> uncached;
+    const Document *recolor = recolorTemplate(filename, &uncached);
+    // Nothing to recolor, the plain renderer does the job
+    if (recolor == nullptr || !recolor->hasStyle)
+        return render(filename, painter, bounds);
+
+    const QString source = recolor->head + recolor->style + styleSheet + recolor->tail;
+    QXmlStreamReader xmlReader(source);
+    auto document = std::make_unique<Document>();
+    document->renderer = std::make_unique<QSvgRenderer>();
+    if (!document->renderer->load(&xmlReader))
+        return false;
+    document->renderer->render(painter, bounds);
+    insert(key, document.release(), source.size() * qsizetype(sizeof(QChar)));
+    return true;
+}
+
+/*
+ * Rasterized icons shared by all the processes of the user through files in
+ * $XDG_CACHE_HOME/qtxdg/icons, so that a starting application doesn't decode
+ * or render again what another one already did. A file holds one raster, in
+ * premultiplied ARGB32, right after a small header. It's mapped and wrapped
+ * by a QImage without any decoding.
+ *
+ * A file is named after the hash of the source file, the pixel size and the
+ * style sheet the icon is recolored with. The modification time and the size
+ * of the source are in the header and checked on lookup; an outdated file is
+ * just overwritten. Files are replaced atomically, a mapping never sees one
+ * being written.
+ *
+ * The directory is kept under a size limit, the files used the least
+ * recently are removed first. A hit touches the modification time of its
+ * file (at most once an hour), which is what the files are ordered by. The
+ * directory is pruned on a worker thread when the cache gets enabled and
+ * then each time a quarter of the limit has been written.
+ *
+ * Disabled by default.
+ */
+class DiskRasterCache
+{
+public:
+    bool isEnabled() const { return m_enabled; }
+    void setEnabled(bool enable);
+    int limit() const { return int(m_limit / 1024); }
+    void setLimit(int kb);
+
+    // A size of 0 stands for the natural size of the source
+    QImage find(const QString &filename, int size, const QString &styleSheet) const;
+    void insert(const QString &filename, int size, const QString &styleSheet, const QImage &image);
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        qint64 mtime;
+        qint64 fileSize;
+        qint32 width;
+        qint32 height;
+    };
+    static constexpr quint32 Magic = 0x43495851; // "QXIC"
+    static constexpr quint32 Version = 1;
+
+    static QString cacheDir();
+    static QString cacheFile(const QString &filename, int size, const QString &styleSheet);
+    static void prune(qint64 limit);
+    void schedulePrune();
+
+    std::atomic<bool> m_enabled{false};
+    std::atomic<qint64> m_limit{64 * 1024 * 1024};
+    // Bytes written since the directory was last pruned
+    std::atomic<qint64> m_written{0};
+};
+Q_GLOBAL_STATIC(DiskRasterCache, diskRasterCache)
+
+QString DiskRasterCache::cacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation) + "/qtxdg/icons/"_L1;
+}
+
+void DiskRasterCache::setEnabled(bool enable)
+{
+    if (enable && !m_enabled.exchange(true))
+        schedulePrune();
+    m_enabled = enable;
+}
+
+void DiskRasterCache::setLimit(int kb)
+{
+    m_limit = qint64(kb) * 1024;
+    if (m_enabled)
+        schedulePrune();
+}
+
+void DiskRasterCache::schedulePrune()
+{
+    m_written = 0;
+    const qint64 limit = m_limit;
+    QThreadPool::globalInstance()->start([limit] { prune(limit); });
+}
+
+// Removes the least recently used files until the directory fits into limit
+void DiskRasterCache::prune(qint64 limit)
+{
+    // The temporary files of QSaveFile have a suffix, they're being written
+    const QFileInfoList files = QDir(cacheDir()).entryInfoList(QDir::Files | QDir::NoDotAndDotDot, QDir::Time);
+    qint64 total = 0;
+    for (const QFileInfo &file : files) {
+        if (file.fileName().contains(u'.'))
+            continue;
+        total += file.size();
+        if (total > limit)
+            QFile::remove(file.filePath());
+    }
+}
+
+QString DiskRasterCache::cacheFile(const QString &filename, int size, const QString &styleSheet)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(filename.toUtf8());
+    hash.addData(QByteArrayView(reinterpret_cast<const char *>(&size), sizeof(size)));
+    hash.addData(styleSheet.toUtf8());
+    return cacheDir() + QString::fromLatin1(hash.result().toHex());
+}
+
+QImage DiskRasterCache::find(const QString &filename, int size, const QString &styleSheet) const
+{
+    const QFileInfo source(filename);
+    auto file = std::make_unique<QFile>(cacheFile(filename, size, styleSheet));
+    if (!file->open(QIODevice::ReadOnly) || file->size() < qint64(sizeof(Header)))
+        return QImage();
+
+    uchar *data = file->map(0, file->size());
+    if (!data)
+        return QImage();
+
+    Header header;
+    memcpy(&header, data, sizeof(Header));
+    if (header.magic != Magic || header.version != Version
+        || header.mtime != source.lastModified().toMSecsSinceEpoch()
+        || header.fileSize != source.size()
+        || header.width <= 0 || header.height <= 0
+        || (size > 0 && (header.width != size || header.height != size))
+        || file->size() != qint64(sizeof(Header)) + qint64(header.width) * header.height * 4)
+    {
+        return QImage();
+    }
+
+    // Keeps the file from being pruned, most of them are used much less often
+    const QDateTime now = QDateTime::currentDateTime();
+    if (file->fileTime(QFileDevice::FileModificationTime).secsTo(now) > 3600)
+        file->setFileTime(now, QFileDevice::FileModificationTime);
+
+    // The image owns the file, the mapping lives as long as the image data.
+    // The mapping is read-only: the image is made from const data, painting
+    // on it detaches a copy first.
+    QFile *owner = file.release();
+    return QImage(static_cast<const uchar *>(data + sizeof(Header)),
+                  header.width, header.height, header.width * 4,
+                  QImage::Format_ARGB32_Premultiplied,
+                  [](void *info) { delete static_cast<QFile *>(info); }, owner);
+}
+
+void DiskRasterCache::insert(const QString &filename, int size, const QString &styleSheet, const QImage &image)
+{
+    const QFileInfo source(filename);
+    if (image.isNull() || !source.exists() || !QDir().mkpath(cacheDir()))
+        return;
+
+    const QImage argb = image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    Header header;
+    header.magic = Magic;
+    header.version = Version;
+    header.mtime = source.lastModified().toMSecsSinceEpoch();
+    header.fileSize = source.size();
+    header.width = argb.width();
+    header.height = argb.height();
+
+    QSaveFile file(cacheFile(filename, size, styleSheet));
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    // 32 bit scan lines are never padded
+    file.write(reinterpret_cast<const char *>(argb.constBits()), argb.sizeInBytes());
+    if (!file.commit())
+        return;
+
+    const qint64 written = m_written += qint64(sizeof(Header)) + argb.sizeInBytes();
+    if (written > m_limit / 4)
+        schedulePrune();
+}
+
+bool XdgIconLoader::diskCacheEnabled() const
+{
+    return diskRasterCache()->isEnabled();
+}
+
+void XdgIconLoader::setDiskCacheEnabled(bool enable)
+{
+    diskRasterCache()->setEnabled(enable);
+}
+
+int XdgIconLoader::diskCacheLimit() const
+{
+    return diskRasterCache()->limit();
+}
+
+void XdgIconLoader::setDiskCacheLimit(int kb)
+{
+    diskRasterCache()->setLimit(kb);
+}
 
-    // Ensure that basePixmap is lazily initialized before generating the
-    // key, otherwise the cache key is not unique
-    if (basePixmap.isNull())
-        basePixmap.load(filename);
+static QPixmap loadBasePixmap(const QString &filename)
+{
+    DiskRasterCache *diskCache = diskRasterCache();
+    if (!diskCache->isEnabled())
+        return QPixmap(filename);
+
+    QImage image = diskCache->find(filename, 0, QString());
+    if (image.isNull()) {
+        image = QImageReader(filename).read();
+        diskCache->insert(filename, 0, QString(), image);
+    }
+    return QPixmap::fromImage(std::move(image));
+}
+
+// Renders a scalable icon into an icnSize square, recolored with styleSheet
+// unless it's empty
+static QPixmap renderScalable(const QString &filename, int icnSize, const QString &styleSheet)
+{
+    DiskRasterCache *diskCache = diskRasterCache();
+    QImage image;
+    if (diskCache->isEnabled())
+        image = diskCache->find(filename, icnSize, styleSheet);
+
+    if (image.isNull()) {
+        image = QImage(icnSize, icnSize, QImage::Format_ARGB32_Premultiplied);
+        image.fill(Qt::transparent);
+
+        QPainter p;
+        p.begin(&image);
+        const bool rendered = styleSheet.isEmpty()
+            ? svgRendererCache()->render(filename, &p, QRect(0, 0, icnSize, icnSize))
+            : svgRendererCache()->renderRecolored(filename, styleSheet, &p, QRect(0, 0, icnSize, icnSize));
+        p.end();
+
+        if (rendered && diskCache->isEnabled())
+            diskCache->insert(filename, icnSize, styleSheet, image);
+    }
+    return QPixmap::fromImage(std::move(image));
+}
+
+int XdgIconLoader::svgCacheLimit() const
+{
+    return svgRendererCache()->limit();
+}
+
+void XdgIconLoader::setSvgCacheLimit(int kb)
+{
+    svgRendererCache()->setLimit(kb);
+}
+
+void SvgRendererCache::removeFiles(const QString &dir)
+{
+    const QString prefix = dir + u'/';
+    const QList<Key> keys = m_documents.keys();
+    for (const Key &key : keys) {
+        if (key.filename.startsWith(prefix))
+            m_documents.remove(key);
+    }
+}
+
+void XdgIconLoader::invalidateContentDir(const QString &contentDir)
+{
+    const QString path = contentDir + u'/';
+    // The files may have been replaced, don't reuse what was rendered from
+    // them. The watcher notifies on the GUI thread, the SVG documents can
+    // be touched.
+    fileIdTable()->forget(contentDir);
+    svgRendererCache()->removeFiles(contentDir);
+
+    {
+        QWriteLocker locker(&m_lock);
+        const QList<XdgIconDirRecord> order = m_searchOrders.value(m_themeName);
+        qsizetype index = 0;
+        while (index < order.size() && order.at(index).path != path)
+            ++index;
+        // Not searched by the current theme, other themes are resolved
+        // again when switching to them
+        if (index == order.size())
+            return;
+
+        // The icons whose lookup stopped before this directory are kept
+        const QList<QString> names = m_resolved.keys();
+        for (const QString &name : names) {
+            const XdgIconInfo *info = m_resolved.object(name);
+            if (info->searchDepth == -1 || info->searchDepth > index)
+                m_resolved.remove(name);
+        }
+        ++m_generation;
+    }
+}
+
+/*
+ * The key of a rendered pixmap. The palette only matters for the modes
+ * styled by it and for the recolored icons, it's 0 otherwise.
+ */
+struct PixmapKey
+{
+    quint32 fileId;
+    qint32 width;
+    qint32 height;
+    quint16 scale; // x 1000
+    quint8 mode;
+    quint8 state;
+    qint64 paletteKey;
+
+    friend bool operator==(const PixmapKey &a, const PixmapKey &b)
+    {
+        return a.fileId == b.fileId && a.width == b.width && a.height == b.height
+            && a.scale == b.scale && a.mode == b.mode && a.state == b.state
+            && a.paletteKey == b.paletteKey;
+    }
+    friend size_t qHash(const PixmapKey &key, size_t seed = 0)
+    {
+        return qHashMulti(seed, key.fileId, key.width, key.height, key.scale,
+                          key.mode, key.state, key.paletteKey);
+    }
+};
+
+static PixmapKey pixmapKey(quint32 fileId, const QSize &size, QIcon::Mode mode,
+                           QIcon::State state, qreal scale, bool followsPalette)
+{
+    return {fileId, size.width(), size.height(), quint16(qRound(scale * 1000)),
+            quint8(mode), quint8(state),
+            followsPalette ? QGuiApplication::palette().cacheKey() : 0};
+}
+
+/*
+ * Maps the pixmaps rendered by the entries to their QPixmapCache keys. A
+ * lookup hashes a few integers and doesn't allocate, unlike the string keys
+ * of QPixmapCache. Evicted pixmaps leave invalid keys behind, they're
+ * dropped on their next lookup or when the map grows too big.
+ *
+ * The file ids outlive a theme switch, while the files may have changed
+ * along with the theme, so all the pixmaps are dropped then.
+ *
+ * Only used on the GUI thread, like QPixmapCache.
+ */
+class PixmapKeyCache
+{
+public:
+    bool find(const PixmapKey &key, QPixmap *pixmap)
+    {
+        checkKey();
+        const auto it = m_keys.constFind(key);
+        if (it == m_keys.constEnd())
+            return false;
+        if (QPixmapCache::find(*it, pixmap))
+            return true;
+        m_keys.erase(it);
+        return false;
+    }
+
+    void insert(const PixmapKey &key, const QPixmap &pixmap)
+    {
+        checkKey();
+        if (m_keys.size() >= MaxKeys)
+            m_keys.removeIf([](const auto &it) { return !it.value().isValid(); });
+        m_keys.insert(key, QPixmapCache::insert(pixmap));
+    }
+
+private:
+    void checkKey()
+    {
+        const uint key = XdgIconLoader::instance()->themeKey();
+        if (m_key == key)
+            return;
+        for (const QPixmapCache::Key &pixmapKey : std::as_const(m_keys))
+            QPixmapCache::remove(pixmapKey);
+        m_keys.clear();
+        m_key = key;
+    }
+
+    static constexpr qsizetype MaxKeys = 4096;
+    QHash<PixmapKey, QPixmapCache::Key> m_keys;
+    uint m_key = 0;
+};
+Q_GLOBAL_STATIC(PixmapKeyCache, pixmapKeyCache)
+
+/*
+ * Decoded base pixmaps of the pixmap entries, shared by all the engines and
+ * keyed by file id. The entries don't hold their own copy: two engines for
+ * the same icon share one, and an icon shown once doesn't stay in memory as
+ * long as its engine. The base pixmap is only needed when the rendered one
+ * isn't in QPixmapCache. The least recently used pixmaps are evicted when
+ * the budget is exceeded.
+ *
+ * Only used on the GUI thread, like QPixmapCache.
+ */
+class BasePixmapCache
+{
+public:
+    QPixmap find(quint32 fileId, const QString &filename);
+    int limit() const { return int(m_pixmaps.maxCost() / 1024); }
+    void setLimit(int kb) { m_pixmaps.setMaxCost(qsizetype(kb) * 1024); }
+
+private:
+    QCache<quint32, QPixmap> m_pixmaps{8 * 1024 * 1024};
+    uint m_key = 0;
+};
+Q_GLOBAL_STATIC(BasePixmapCache, basePixmapCache)
+
+QPixmap BasePixmapCache::find(quint32 fileId, const QString &filename)
+{
+    // The files may have changed along with the theme
+    const uint key = XdgIconLoader::instance()->themeKey();
+    if (m_key != key) {
+        m_pixmaps.clear();
+        m_key = key;
+    }
+
+    if (const QPixmap *pixmap = m_pixmaps.object(fileId))
+        return *pixmap;
+
+    const QPixmap pixmap = loadBasePixmap(filename);
+    if (!pixmap.isNull()) {
+        const qsizetype cost = qsizetype(pixmap.width()) * pixmap.height() * pixmap.depth() / 8;
+        m_pixmaps.insert(fileId, new QPixmap(pixmap), cost);
+    }
+    return pixmap;
+}
+
+int XdgIconLoader::imageCacheLimit() const
+{
+    return basePixmapCache()->limit();
+}
+
+void XdgIconLoader::setImageCacheLimit(int kb)
+{
+    basePixmapCache()->setLimit(kb);
+}
+
+static QPixmap pixmapEntryPixmap(const QString &filename, quint32 fileId, const QSize &size,
+                                 QIcon::Mode mode, qreal scale)
+{
+    QPixmap cachedPixmap;
+    // The base pixmap and so the result only depend on the file
+    const PixmapKey key = pixmapKey(fileId, size, mode, QIcon::Off, scale, mode != QIcon::Normal);
+    if (pixmapKeyCache()->find(key, &cachedPixmap))
+        return cachedPixmap;
+
+    const QPixmap basePixmap = basePixmapCache()->find(fileId, filename);
 
     // see QPixmapIconEngine::adjustSize
     QSize actualSize = basePixmap.size();
@@ -804,99 +2202,53 @@ QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State st
                              qreal(actualSize.height() / qreal(targetSize.height())));
         calculatedDpr = std::max(qreal(1.0), scale * ratio);
     }
-
-    QString key = "$qt_theme_"_L1
-                  % HexString<quint64>(basePixmap.cacheKey())
-                  % HexString<quint8>(mode)
-                  % HexString<quint64>(QGuiApplication::palette().cacheKey())
-                  % HexString<uint>(actualSize.width())
-                  % HexString<uint>(actualSize.height())
-                  % HexString<quint16>(qRound(calculatedDpr * 1000));
-#else
-    QString key = "$qt_theme_"_L1
-                  % HexString<qint64>(basePixmap.cacheKey())
-                  % HexString<int>(mode)
-                  % HexString<qint64>(QGuiApplication::palette().cacheKey())
-                  % HexString<int>(actualSize.width())
-                  % HexString<int>(actualSize.height());
 #endif
 
-    QPixmap cachedPixmap;
-    if (QPixmapCache::find(key, &cachedPixmap)) {
-        return cachedPixmap;
-    } else {
-        if (basePixmap.size() != actualSize)
-            cachedPixmap = basePixmap.scaled(actualSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
-        else
-            cachedPixmap = basePixmap;
-        if (QGuiApplication *guiApp = qobject_cast<QGuiApplication *>(qApp))
-            cachedPixmap = static_cast<QGuiApplicationPrivate*>(QObjectPrivate::get(guiApp))->applyQIconStyleHelper(mode, cachedPixmap);
+    if (basePixmap.size() != actualSize)
+        cachedPixmap = basePixmap.scaled(actualSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    else
+        cachedPixmap = basePixmap;
+    cachedPixmap = applyIconStyle(mode, cachedPixmap);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        cachedPixmap.setDevicePixelRatio(calculatedDpr);
+    cachedPixmap.setDevicePixelRatio(calculatedDpr);
 #endif
-        QPixmapCache::insert(key, cachedPixmap);
-    }
+    pixmapKeyCache()->insert(key, cachedPixmap);
     return cachedPixmap;
 }
 
-// NOTE: For SVG, QSvgRenderer is used to prevent our icon handling from
-// being broken by icon engines that register themselves for SVG.
+// XXX: duplicated from qiconloader.cpp, because this symbol isn't exported :(
+// Only XdgPixmapEntry is ever created, this is needed for its base vtable.
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
-#else
-QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
-#endif
+QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
 {
-    QPixmap pm;
-    if (size.isEmpty())
-        return pm;
+    Q_UNUSED(state);
+    return pixmapEntryPixmap(filename, fileIdTable()->id(filename), size, mode, scale);
+}
 
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-    QString key = "lxqt_"_L1
-                  % filename
-                  % HexString<quint8>(mode)
-                  % HexString<int>(state)
-                  % HexString<uint>(size.width())
-                  % HexString<uint>(size.height())
-                  % HexString<quint16>(qRound(scale * 1000));
-#else
-    QString key = "lxqt_"_L1
-                  % filename
-                  % HexString<int>(mode)
-                  % HexString<int>(state)
-                  % HexString<int>(size.width())
-                  % HexString<int>(size.height());
-#endif
-    if (!QPixmapCache::find(key, &pm))
-    {
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        int icnSize = std::min(size.width(), size.height()) * scale;
+QPixmap XdgPixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
+{
+    Q_UNUSED(state);
+    return pixmapEntryPixmap(filename, fileId, size, mode, scale);
+}
 #else
-        int icnSize = std::min(size.width(), size.height());
-#endif
-        pm = QPixmap(icnSize, icnSize);
-        pm.fill(Qt::transparent);
-
-        QSvgRenderer renderer;
-        if (renderer.load(filename))
-        {
-            QPainter p;
-            p.begin(&pm);
-            renderer.render(&p, QRect(0, 0, icnSize, icnSize));
-            p.end();
-        }
+QPixmap PixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    Q_UNUSED(state);
+    return pixmapEntryPixmap(filename, fileIdTable()->id(filename), size, mode, 1.0);
+}
 
-        svgIcon = QIcon(pm);
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        pm = svgIcon.pixmap(size, scale, mode, state);
-#else
-        if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
-            pm = engine->pixmap(size, mode, state);
+QPixmap XdgPixmapEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    Q_UNUSED(state);
+    return pixmapEntryPixmap(filename, fileId, size, mode, 1.0);
+}
 #endif
-        QPixmapCache::insert(key, pm);
-    }
 
-    return pm;
+QSize XdgPixmapEntry::baseSize()
+{
+    if (!m_baseSize.isValid())
+        m_baseSize = QImageReader(filename).size();
+    return m_baseSize;
 }
 
 static const QString STYLE = u"\n.ColorScheme-Text, .ColorScheme-NeutralText {color:%1;}\
@@ -905,16 +2257,8 @@ static const QString STYLE = u"\n.ColorScheme-Text, .ColorScheme-NeutralText {co
 // NOTE: Qt palette does not have any colors for positive/negative text
 // .ColorScheme-PositiveText,ColorScheme-NegativeText {color:%4;}
 
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
-#else
-QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
-#endif
+static QString colorSchemeStyle(QIcon::Mode mode)
 {
-    QPixmap pm;
-    if (size.isEmpty())
-        return pm;
-
     const QPalette pal = qApp->palette();
     QString txtCol, bgCol, hCol;
     if (mode == QIcon::Disabled)
@@ -937,93 +2281,72 @@ QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, Q
         }
         hCol = pal.highlight().color().name();
     }
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-    QString key = "lxqt_"_L1
-                  % filename
-                  % HexString<quint8>(mode)
-                  % HexString<int>(state)
-                  % HexString<uint>(size.width())
-                  % HexString<uint>(size.height())
-                  % HexString<quint16>(qRound(scale * 1000))
-                  % txtCol % bgCol % hCol;
-#else
-    QString key = "lxqt_"_L1
-                  % filename
-                  % HexString<int>(mode)
-                  % HexString<int>(state)
-                  % HexString<int>(size.width())
-                  % HexString<int>(size.height())
-                  % txtCol % bgCol % hCol;
-#endif
-    if (!QPixmapCache::find(key, &pm))
-    {
-#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        int icnSize = std::min(size.width(), size.height()) * scale;
-#else
-        int icnSize = std::min(size.width(), size.height());
-#endif
-        pm = QPixmap(icnSize, icnSize);
-        pm.fill(Qt::transparent);
+    return STYLE.arg(txtCol, bgCol, hCol);
+}
 
-        QFile device{filename};
-        if (device.open(QIODevice::ReadOnly))
-        {
-            QString styleSheet = STYLE.arg(txtCol, bgCol, hCol);
-            QByteArray svgBuffer;
-            QXmlStreamWriter writer(&svgBuffer);
-            QXmlStreamReader xmlReader(&device);
-            while (!xmlReader.atEnd())
-            {
-                if (xmlReader.readNext() == QXmlStreamReader::StartElement
-                    && xmlReader.qualifiedName() == "style"_L1
-                    && xmlReader.attributes().value("id"_L1) == "current-color-scheme"_L1)
-                {
-                    const auto attribs = xmlReader.attributes();
-                    // store original data/text of the <style> element
-                    QString origData;
-                    while (xmlReader.tokenType() != QXmlStreamReader::EndElement)
-                    {
-                        if (xmlReader.tokenType() == QXmlStreamReader::Characters)
-                            origData += xmlReader.text();
-                        xmlReader.readNext();
-                    }
-                    writer.writeStartElement("style"_L1);
-                    writer.writeAttributes(attribs);
-                    writer.writeCharacters(origData);
-                    writer.writeCharacters(styleSheet);
-                    writer.writeEndElement();
-                }
-                else if (xmlReader.tokenType() != QXmlStreamReader::Invalid)
-                    writer.writeCurrentToken(xmlReader);
-            }
+// NOTE: For SVG, QSvgRenderer is used to prevent our icon handling from
+// being broken by icon engines that register themselves for SVG.
+static QPixmap scalableEntryPixmap(const QString &filename, quint32 fileId, bool followsColorScheme,
+                                   const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
+{
+    QPixmap pm;
+    if (size.isEmpty())
+        return pm;
 
-            if (!svgBuffer.isEmpty())
-            {
-                QSvgRenderer renderer;
-                renderer.load(svgBuffer);
-                QPainter p;
-                p.begin(&pm);
-                renderer.render(&p, QRect(0, 0, icnSize, icnSize));
-                p.end();
-            }
-        }
+    const PixmapKey key = pixmapKey(fileId, size, mode, state, scale,
+                                    followsColorScheme || mode != QIcon::Normal);
+    if (!pixmapKeyCache()->find(key, &pm))
+    {
+        int icnSize = std::min(size.width(), size.height()) * scale;
+        pm = renderScalable(filename, icnSize, followsColorScheme ? colorSchemeStyle(mode) : QString());
 
-        // Do not use this pixmap directly but first get the icon
-        // for QIcon::pixmap() to handle states and modes,
-        // especially the disabled mode.
-        svgIcon = QIcon(pm);
+        // The pixmap already has the requested size, so only the mode is
+        // left to apply; no need to go through a temporary QIcon for that.
+        // The colors of recolored icons only follow the palette, the mode
+        // (especially the disabled one) still needs its style on top.
+        pm = applyIconStyle(mode, pm);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-        pm = svgIcon.pixmap(size, scale, mode, state);
-#else
-        if (QIconEngine *engine = svgIcon.data_ptr() ? svgIcon.data_ptr()->engine : nullptr)
-            pm = engine->pixmap(size, mode, state);
+        pm.setDevicePixelRatio(scale);
 #endif
-        QPixmapCache::insert(key, pm);
+        pixmapKeyCache()->insert(key, pm);
     }
 
     return pm;
 }
 
+// Only XdgScalableEntry is ever created, this is needed for its base vtable.
+#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
+QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
+{
+    return scalableEntryPixmap(filename, fileIdTable()->id(filename), false, size, mode, state, scale);
+}
+
+QPixmap XdgScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
+{
+    return scalableEntryPixmap(filename, fileId, false, size, mode, state, scale);
+}
+
+QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
+{
+    return scalableEntryPixmap(filename, fileId, true, size, mode, state, scale);
+}
+#else
+QPixmap ScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    return scalableEntryPixmap(filename, fileIdTable()->id(filename), false, size, mode, state, 1.0);
+}
+
+QPixmap XdgScalableEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    return scalableEntryPixmap(filename, fileId, false, size, mode, state, 1.0);
+}
+
+QPixmap ScalableFollowsColorEntry::pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state)
+{
+    return scalableEntryPixmap(filename, fileId, true, size, mode, state, 1.0);
+}
+#endif
+
 QPixmap XdgIconLoaderEngine::pixmap(const QSize &size, QIcon::Mode mode,
                                  QIcon::State state)
 {
@@ -1037,26 +2360,29 @@ QString XdgIconLoaderEngine::key() const
 
 QString XdgIconLoaderEngine::iconName()
 {
+    QMutexLocker locker(&m_mutex);
     ensureLoaded();
     return m_info.iconName;
 }
 
 bool XdgIconLoaderEngine::isNull()
 {
+    QMutexLocker locker(&m_mutex);
     ensureLoaded();
     return m_info.entries.empty();
 }
 
 QPixmap XdgIconLoaderEngine::scaledPixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale)
 {
+    QMutexLocker locker(&m_mutex);
     ensureLoaded();
     const int integerScale = std::ceil(scale);
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size, integerScale);
-    return entry ? entry->pixmap(size, mode, state, scale) : QPixmap();
+    const qsizetype index = entryIndexForSize(size, integerScale);
+    return index >= 0 ? m_info.entries[index]->pixmap(size, mode, state, scale) : QPixmap();
 #else
-    QIconLoaderEngineEntry *entry = entryForSize(m_info, size / integerScale, integerScale);
-    return entry ? entry->pixmap(size, mode, state) : QPixmap();
+    const qsizetype index = entryIndexForSize(size / integerScale, integerScale);
+    return index >= 0 ? m_info.entries[index]->pixmap(size, mode, state) : QPixmap();
 #endif
 }
 
@@ -1064,15 +2390,24 @@ QList<QSize> XdgIconLoaderEngine::availableSizes(QIcon::Mode mode, QIcon::State
 {
     Q_UNUSED(mode);
     Q_UNUSED(state);
+    QMutexLocker locker(&m_mutex);
     ensureLoaded();
     const int N = m_info.entries.size();
     QList<QSize> sizes;
     sizes.reserve(N);
 
     // Gets all sizes from the DirectoryInfo entries
-    for (const auto &entry : m_info.entries) {
+    for (qsizetype i = 0; i < N; ++i) {
+        QIconLoaderEngineEntry *entry = m_info.entries[i].get();
         if (entry->dir.type == QIconDirInfo::Fallback) {
-            sizes.append(QIcon(entry->filename).availableSizes());
+            // Only read the header of pixmaps, don't decode them
+            if (m_kinds.at(i) == XdgIconEntryInfo::Pixmap) {
+                const QSize size = static_cast<XdgPixmapEntry *>(entry)->baseSize();
+                if (size.isValid())
+                    sizes.append(size);
+            } else {
+                sizes.append(QIcon(entry->filename).availableSizes());
+            }
         } else {
             int size = entry->dir.size;
             sizes.append(QSize(size, size));
@@ -54,13 +54,79 @@
 #include <QtGui/QIconEngine>
 #include <private/qicon_p.h>
 #include <private/qiconloader_p.h>
+#include <QtCore/QCache>
 #include <QtCore/QHash>
 #include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QReadWriteLock>
+#include <QtCore/QThreadPool>
+
+#include <atomic>
 
 //QT_BEGIN_NAMESPACE
 
 class XdgIconLoader;
 
+/*
+ * Cheap, copyable description of an icon file found during a theme lookup.
+ * Resolved icons are cached in this form, so that creating the engine
+ * entries again doesn't touch the file system.
+ */
+struct XdgIconEntryInfo
+{
+    enum Kind {
+        Pixmap,
+        Scalable,
+        ScalableFollowsColor
+    };
+
+    QString filename;
+    QIconDirInfo dir;
+    Kind kind = Pixmap;
+    // Compact id of the file, keys its rendered pixmaps
+    quint32 fileId = 0;
+};
+
+struct XdgIconInfo
+{
+    QList<XdgIconEntryInfo> entries;
+    QString iconName;
+    // The number of leading directories of the search order the result
+    // depends on, a change in a later one can't alter it. -1 for all of them.
+    qsizetype searchDepth = -1;
+    // The generation of the loader when the icon was resolved
+    uint generation = 0;
+};
+
+/*
+ * The engine entries carry the id of their file, so that looking up their
+ * rendered pixmaps doesn't build string keys.
+ */
+struct XdgPixmapEntry : public PixmapEntry
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale) override;
+#else
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
+#endif
+    // The size of the image, read from its header. basePixmap stays null,
+    // the decoded images are shared by all the entries.
+    QSize baseSize();
+    quint32 fileId = 0;
+private:
+    QSize m_baseSize;
+};
+
+struct XdgScalableEntry : public ScalableEntry
+{
+#if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state, qreal scale) override;
+#else
+    QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
+#endif
+    quint32 fileId = 0;
+};
+
 struct ScalableFollowsColorEntry : public QIconLoaderEngineEntry
 {
 #if (QT_VERSION >= QT_VERSION_CHECK(6,8,0))
@@ -68,7 +134,7 @@ struct ScalableFollowsColorEntry : public QIconLoaderEngineEntry
 #else
     QPixmap pixmap(const QSize &size, QIcon::Mode mode, QIcon::State state) override;
 #endif
-    QIcon svgIcon;
+    quint32 fileId = 0;
 };
 
 //class QIconLoaderEngine : public QIconEngine
@@ -95,10 +161,21 @@ private:
     bool hasIcon() const;
     void ensureLoaded();
     QIconLoaderEngineEntry *entryForSize(const QThemeIconInfo &info, const QSize &size, int scale = 1);
+    qsizetype entryIndexForSize(const QSize &size, int scale);
     XdgIconLoaderEngine(const XdgIconLoaderEngine &other);
+    // QIcon shares its engine between copies, which may be queried from
+    // several threads. Guards the lazily loaded members below.
+    QMutex m_mutex;
     QThemeIconInfo m_info;
+    // The kind of each entry of m_info
+    QList<XdgIconEntryInfo::Kind> m_kinds;
+    // The entry picked for each requested (size, scale), -1 if none
+    QHash<quint64, qsizetype> m_entryForSize;
     QString m_iconName;
     uint m_key;
+    // The generation of the loader last checked, and of the icon loaded
+    uint m_generation = 0;
+    uint m_infoGeneration = 0;
 
     friend class XdgIconLoader;
 };
@@ -110,11 +187,11 @@ class QIconCacheGtkReader;
 class XdgIconTheme
 {
 public:
-    XdgIconTheme(const QString &name);
+    XdgIconTheme(const QString &name, const QStringList &searchPaths);
     XdgIconTheme() = default;
-    QStringList parents() { return m_parents; }
-    QList <QIconDirInfo> keyList() { return m_keyList; }
-    QStringList contentDirs() { return m_contentDirs; }
+    QStringList parents() const { return m_parents; }
+    QList <QIconDirInfo> keyList() const { return m_keyList; }
+    QStringList contentDirs() const { return m_contentDirs; }
     bool isValid() const { return m_valid; }
     bool followsColorScheme() const { return m_followsColorScheme; }
 private:
@@ -127,13 +204,34 @@ public:
     QList<QSharedPointer<QIconCacheGtkReader>> m_gtkCaches;
 };
 
+/*
+ * One content directory of a theme. The lookups search a flat list of them:
+ * the theme, its parents depth first, then hicolor. The list of each theme
+ * is built once, lookups don't walk the inheritance anymore.
+ */
+struct XdgIconDirRecord
+{
+    // With a trailing slash
+    QString path;
+    QSharedPointer<QIconCacheGtkReader> gtkCache;
+    QList<QIconDirInfo> dirs;
+    // Index of the theme in the search order, an icon is taken from the
+    // first theme that has it
+    int theme = 0;
+    bool followsColorScheme = false;
+};
+
 class XDGICONLOADER_EXPORT XdgIconLoader
 {
 public:
+    XdgIconLoader();
+
     QThemeIconInfo loadIcon(const QString &iconName) const;
 
+    // The key of the theme currentTheme() reports, safe on any thread
+    uint themeKey() const;
+
     /* TODO: deprecate & remove all QIconLoader wrappers */
-    inline uint themeKey() const { return QIconLoader::instance()->themeKey(); }
     inline QString themeName() const { return QIconLoader::instance()->themeName(); }
     inline void setThemeName(const QString &themeName) { QIconLoader::instance()->setThemeName(themeName); }
     inline void setThemeSearchPath(const QStringList &searchPaths) { QIconLoader::instance()->setThemeSearchPath(searchPaths); }
@@ -150,17 +248,123 @@ public:
     inline bool followColorScheme() const { return m_followColorScheme; }
     void setFollowColorScheme(bool enable);
 
-    XdgIconTheme theme() { return themeList.value(QIconLoader::instance()->themeName()); }
+    /*!
+     * The memory budget, in kilobytes, of the parsed SVG documents kept for
+     * rendering scalable icons in new sizes. The default is 4096 KB.
+     */
+    int svgCacheLimit() const;
+    void setSvgCacheLimit(int kb);
+
+    /*!
+     * The memory budget, in kilobytes, of the decoded images of the pixmap
+     * icons, shared by all the engines. The default is 8192 KB.
+     */
+    int imageCacheLimit() const;
+    void setImageCacheLimit(int kb);
+
+    /*!
+     * Flag if the rasterized icons are also kept on disk, in
+     * $XDG_CACHE_HOME/qtxdg/icons, and shared with the other processes.
+     * Icons already rendered by another application are then loaded
+     * without decoding or rendering. Disabled by default.
+     */
+    bool diskCacheEnabled() const;
+    void setDiskCacheEnabled(bool enable);
+
+    /*!
+     * The size limit, in kilobytes, of the disk cache. The least recently
+     * used icons are removed from it when it's exceeded. The default is
+     * 65536 KB.
+     */
+    int diskCacheLimit() const;
+    void setDiskCacheLimit(int kb);
+
+    /*!
+     * Resolves \a iconNames on a worker thread, so that the engines created
+     * for them afterwards don't have to search the theme. If \a sizes isn't
+     * empty, the icons are also rendered in these sizes into QPixmapCache.
+     * The rendering happens in small batches on the GUI thread, as pixmaps
+     * can't be created anywhere else.
+     *
+     * Must be called from the GUI thread.
+     */
+    void prewarm(const QStringList &iconNames, const QList<int> &sizes = QList<int>());
+
+    /*!
+     * Resolves \a iconNames in the current theme and caches the results,
+     * using idle threads of the global thread pool. Returns when all of
+     * them are resolved.
+     */
+    void resolve(const QStringList &iconNames) const;
+
+    /*!
+     * Returns the index of the first of \a iconNames found in the current
+     * theme, dash fallbacks included, or -1. All the names are searched in
+     * a single pass over the theme directories; the result is cached for
+     * the following loadIcon() calls.
+     */
+    qsizetype resolveFirst(const QStringList &iconNames) const;
+
+    /*!
+     * The memory, in bytes, held by an engine of \a iconName: the engine
+     * and its entries, if the icon is resolved in the current theme
+     * already. \a resolved tells if it is; nothing is searched. The
+     * rendered pixmaps aren't counted, the engines share them.
+     */
+    qsizetype engineCost(const QString &iconName, bool *resolved) const;
+
+    /*!
+     * Drops the icons of the current theme whose lookup went through the
+     * theme content directory \a contentDir, so that only they are resolved
+     * again. Called when the directory changed on disk.
+     */
+    void invalidateContentDir(const QString &contentDir);
+
+    /*!
+     * Changes each time some resolved icons were invalidated without a
+     * theme change. The engines compare it to reload only these icons.
+     */
+    uint generation() const { return m_generation; }
+
+    XdgIconTheme theme();
     static XdgIconLoader *instance();
 
 private:
-    QThemeIconInfo findIconHelper(const QString &themeName,
-                                  const QString &iconName,
-                                  QStringList &visited,
-                                  bool dashFallback = false) const;
-    QThemeIconInfo unthemedFallback(const QString &iconName, const QStringList &searchPaths) const;
+    XdgIconInfo resolveIcon(const QString &iconName, const QString &themeName, uint key) const;
+    XdgIconTheme findTheme(const QString &themeName) const;
+    QList<XdgIconDirRecord> searchOrder(const QString &themeName) const;
+    void appendSearchOrder(const QString &themeName, QList<XdgIconDirRecord> &order,
+                           QStringList &visited) const;
+    XdgIconInfo findIconHelper(const QString &themeName,
+                               const QStringList &iconNames,
+                               bool dashFallback = false,
+                               qsizetype *found = nullptr) const;
+    XdgIconInfo unthemedFallback(const QString &iconName, const QStringList &searchPaths) const;
+    XdgIconInfo unthemedIcon(const QString &iconName) const;
+    void currentTheme(QString *themeName, uint *key) const;
+    const XdgIconInfo *cachedIcon(const QString &name) const;
+
+    friend class XdgIconLoaderEngine;
+
+    // Guards themeList, the resolved icons and the theme snapshot. The
+    // searches run without it, so resolving from several threads doesn't
+    // serialize.
+    mutable QReadWriteLock m_lock;
     mutable QHash <QString, XdgIconTheme> themeList;
-    bool m_followColorScheme = true;
+    mutable QHash <QString, QList<XdgIconDirRecord>> m_searchOrders;
+    // The lookups reorder it, they need m_lock for writing. A miss is kept
+    // until the generation changes, the icon may be installed later.
+    mutable QCache <QString, XdgIconInfo> m_resolved{4096};
+    mutable QString m_themeName;
+    mutable uint m_resolvedKey = 0;
+    // QIcon's search paths when the key was taken, the other threads can't
+    // ask QIcon
+    mutable QStringList m_themeSearchPaths;
+    mutable QStringList m_fallbackSearchPaths;
+    std::atomic<uint> m_generation{0};
+    std::atomic<bool> m_followColorScheme{true};
+    // Keep it last, its destructor waits for the running prewarm job
+    QThreadPool m_prewarmPool;
 };
 
 #endif // QT_NO_ICON
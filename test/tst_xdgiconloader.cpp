@@ -0,0 +1,702 @@
+/*
+ * libqtxdg - An Qt implementation of freedesktop.org xdg specs
+ * Copyright (C) 2026  LXQt team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "xdgicon.h"
+
+#include <private/xdgiconloader/xdgiconloader_p.h>
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QPixmapCache>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTest>
+#include <QThread>
+#include <QThreadPool>
+
+#include <atomic>
+
+using namespace Qt::Literals::StringLiterals;
+
+static const char indexTheme[] =
+    "[Icon Theme]\n"
+    "Name=tst-theme\n"
+    "Directories=16x16/apps,32x32/apps,scalable/apps\n"
+    "\n"
+    "[16x16/apps]\n"
+    "Size=16\n"
+    "Type=Fixed\n"
+    "\n"
+    "[32x32/apps]\n"
+    "Size=32\n"
+    "Type=Fixed\n"
+    "\n"
+    "[scalable/apps]\n"
+    "Size=16\n"
+    "MinSize=8\n"
+    "MaxSize=512\n"
+    "Type=Scalable\n";
+
+static const char childIndexTheme[] =
+    "[Icon Theme]\n"
+    "Name=tst-child\n"
+    "Inherits=tst-theme\n"
+    "Directories=scalable/apps\n"
+    "\n"
+    "[scalable/apps]\n"
+    "Size=16\n"
+    "MinSize=8\n"
+    "MaxSize=512\n"
+    "Type=Scalable\n";
+
+static const char svgIcon[] =
+    "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"16\" height=\"16\">"
+    "<rect width=\"16\" height=\"16\" fill=\"#ff0000\"/>"
+    "</svg>\n";
+
+static const char gtkIndexTheme[] =
+    "[Icon Theme]\n"
+    "Name=tst-gtk\n"
+    "Directories=16x16/apps,32x32/apps\n"
+    "\n"
+    "[16x16/apps]\n"
+    "Size=16\n"
+    "Type=Fixed\n"
+    "\n"
+    "[32x32/apps]\n"
+    "Size=32\n"
+    "Type=Fixed\n";
+
+// An icon-theme.cache laid out like gtk-update-icon-cache does, listing a
+// single PNG icon in the directories of dirIndexes
+static QByteArray gtkIconCache(const QString &iconName, const QStringList &dirs,
+                               const QList<quint16> &dirIndexes)
+{
+    const quint32 hashOffset = 12;
+    const quint32 iconOffset = hashOffset + 8;
+    const quint32 imageListOffset = iconOffset + 12;
+    const quint32 dirListOffset = imageListOffset + 4 + 8 * quint32(dirIndexes.size());
+    const quint32 stringsOffset = dirListOffset + 4 + 4 * quint32(dirs.size());
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << quint16(1) << quint16(0) << hashOffset << dirListOffset;
+    // A single bucket, the icon ends its chain
+    out << quint32(1) << iconOffset;
+    out << quint32(0xffffffff) << stringsOffset << imageListOffset;
+    out << quint32(dirIndexes.size());
+    for (const quint16 index : dirIndexes)
+        out << index << quint16(0x4) << quint32(0);
+
+    QByteArray strings = iconName.toUtf8() + '\0';
+    out << quint32(dirs.size());
+    for (const QString &dir : dirs) {
+        out << quint32(stringsOffset + strings.size());
+        strings += dir.toUtf8() + '\0';
+    }
+    return data + strings;
+}
+
+class tst_xdgiconloader : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testLoadIcon();
+    void testDashFallback();
+    void testInheritance();
+    void testResolveFirst();
+    void testConcurrentLoadIcon();
+    void testScalablePixmap();
+    void testDiskCache();
+    void testImageCacheLimit();
+    void testFromThemeBatch();
+    void testLazyFallback();
+    void testIconCacheLimit();
+    void testContentDirInvalidation();
+    void testLateIcon();
+    void testWorkerFirst();
+    void testThemeSwitchPixmaps();
+    void testGtkCache();
+
+    void benchmarkScalablePixmap_data();
+    void benchmarkScalablePixmap();
+    void benchmarkCachedPixmap();
+    void benchmarkSizeSelection();
+    void benchmarkFromTheme_data();
+    void benchmarkFromTheme();
+    void benchmarkThemeSwitch();
+    void benchmarkGtkCacheLookup_data();
+    void benchmarkGtkCacheLookup();
+
+private:
+    bool writeFile(const QString &fileName, const QByteArray &data);
+    bool writePng(const QString &fileName, int size);
+    bool writeGtkCache(const QString &fileName, const QByteArray &data);
+
+    QTemporaryDir m_iconsDir;
+    QStringList m_iconNames;
+    QStringList m_previousSearchPaths;
+    QString m_previousThemeName;
+};
+
+bool tst_xdgiconloader::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+// The cache is only used if it's newer than all its directories
+bool tst_xdgiconloader::writeGtkCache(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size() && file.flush()
+        && file.setFileTime(QDateTime::currentDateTime().addSecs(1), QFileDevice::FileModificationTime);
+}
+
+bool tst_xdgiconloader::writePng(const QString &fileName, int size)
+{
+    QImage image(size, size, QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::red);
+    return image.save(fileName, "PNG");
+}
+
+void tst_xdgiconloader::initTestCase()
+{
+    QStandardPaths::setTestModeEnabled(true);
+    QVERIFY(m_iconsDir.isValid());
+
+    const QString themeDir = m_iconsDir.filePath(u"tst-theme"_s);
+    QVERIFY(QDir().mkpath(themeDir + u"/16x16/apps"_s));
+    QVERIFY(QDir().mkpath(themeDir + u"/32x32/apps"_s));
+    QVERIFY(QDir().mkpath(themeDir + u"/scalable/apps"_s));
+    QVERIFY(writeFile(themeDir + u"/index.theme"_s, indexTheme));
+
+    for (int i = 0; i < 64; ++i) {
+        const QString name = u"tst-app%1"_s.arg(i);
+        QVERIFY(writePng(themeDir + u"/16x16/apps/"_s + name + u".png"_s, 16));
+        QVERIFY(writePng(themeDir + u"/32x32/apps/"_s + name + u".png"_s, 32));
+        if (i % 2 == 0)
+            QVERIFY(writeFile(themeDir + u"/scalable/apps/"_s + name + u".svg"_s, svgIcon));
+        m_iconNames << name;
+    }
+    QVERIFY(writeFile(themeDir + u"/scalable/apps/tst-dash.svg"_s, svgIcon));
+
+    const QString childDir = m_iconsDir.filePath(u"tst-child"_s);
+    QVERIFY(QDir().mkpath(childDir + u"/scalable/apps"_s));
+    QVERIFY(writeFile(childDir + u"/index.theme"_s, childIndexTheme));
+    QVERIFY(writeFile(childDir + u"/scalable/apps/tst-app0.svg"_s, svgIcon));
+    QVERIFY(writeFile(childDir + u"/scalable/apps/tst-dash-more.svg"_s, svgIcon));
+
+    // A theme as big as the biggest ones around, most directories are empty
+    const QString bigDir = m_iconsDir.filePath(u"tst-big"_s);
+    QVERIFY(QDir().mkpath(bigDir + u"/16x16/apps"_s));
+    QByteArray bigIndex = "[Icon Theme]\nName=tst-big\nInherits=tst-theme\n";
+    for (int i = 0; i < 1200; ++i) {
+        bigIndex += QByteArray("\n[%1x%1/ctx%2]\nSize=%1\nType=Fixed\nContext=Applications\n")
+                        .replace("%1", QByteArray::number(16 + i % 8 * 8))
+                        .replace("%2", QByteArray::number(i));
+    }
+    QVERIFY(writeFile(bigDir + u"/index.theme"_s, bigIndex));
+
+    m_previousSearchPaths = QIcon::themeSearchPaths();
+    m_previousThemeName = QIcon::themeName();
+    QIcon::setThemeSearchPaths(QStringList() << m_iconsDir.path());
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::cleanupTestCase()
+{
+    QIcon::setThemeSearchPaths(m_previousSearchPaths);
+    QIcon::setThemeName(m_previousThemeName);
+}
+
+void tst_xdgiconloader::testLoadIcon()
+{
+    const QThemeIconInfo info = XdgIconLoader::instance()->loadIcon(u"tst-app0"_s);
+    QCOMPARE(info.iconName, u"tst-app0"_s);
+    QCOMPARE(int(info.entries.size()), 3);
+    // Pixmaps always come first
+    QVERIFY(info.entries.front()->filename.endsWith(u".png"_s));
+    QVERIFY(info.entries.back()->filename.endsWith(u".svg"_s));
+
+    QVERIFY(XdgIconLoader::instance()->loadIcon(u"tst-missing"_s).entries.empty());
+    QVERIFY(!XdgIcon::fromTheme(u"tst-app1"_s).isNull());
+    QVERIFY(XdgIcon::fromTheme(u"tst-missing"_s).isNull());
+}
+
+void tst_xdgiconloader::testDashFallback()
+{
+    const QThemeIconInfo info = XdgIconLoader::instance()->loadIcon(u"tst-dash-more-specific"_s);
+    QCOMPARE(info.iconName, u"tst-dash"_s);
+    QCOMPARE(int(info.entries.size()), 1);
+}
+
+void tst_xdgiconloader::testInheritance()
+{
+    QIcon::setThemeName(u"tst-child"_s);
+
+    // The icon is taken from the first theme that has it
+    QThemeIconInfo info = XdgIconLoader::instance()->loadIcon(u"tst-app0"_s);
+    QCOMPARE(int(info.entries.size()), 1);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-child/"_s));
+
+    info = XdgIconLoader::instance()->loadIcon(u"tst-app1"_s);
+    QCOMPARE(int(info.entries.size()), 2);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-theme/"_s));
+
+    // Dash fallbacks only start once all the themes are searched
+    info = XdgIconLoader::instance()->loadIcon(u"tst-dash-more-specific"_s);
+    QCOMPARE(info.iconName, u"tst-dash-more"_s);
+    info = XdgIconLoader::instance()->loadIcon(u"tst-dash-less"_s);
+    QCOMPARE(info.iconName, u"tst-dash"_s);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-theme/"_s));
+
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::testResolveFirst()
+{
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    QCOMPARE(loader->resolveFirst({u"tst-missing"_s, u"tst-app10"_s, u"tst-app11"_s}), 1);
+    QCOMPARE(loader->resolveFirst({u"tst-missing"_s, u"tst-missing2"_s}), -1);
+    // A dash fallback of a name comes before the next name
+    QCOMPARE(loader->resolveFirst({u"tst-dash-missing"_s, u"tst-app12"_s}), 0);
+    QCOMPARE(loader->loadIcon(u"tst-dash-missing"_s).iconName, u"tst-dash"_s);
+    QCOMPARE(loader->loadIcon(u"tst-app10"_s).iconName, u"tst-app10"_s);
+    QVERIFY(loader->loadIcon(u"tst-missing"_s).entries.empty());
+}
+
+void tst_xdgiconloader::testConcurrentLoadIcon()
+{
+    const QStringList names = m_iconNames;
+    std::atomic<int> failures{0};
+    std::atomic<int> running{0};
+
+    QList<QThread *> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads << QThread::create([&names, &failures, &running] {
+            for (int round = 0; round < 20; ++round) {
+                for (const QString &name : names) {
+                    const QThemeIconInfo info = XdgIconLoader::instance()->loadIcon(name);
+                    if (info.entries.empty() || info.iconName != name)
+                        ++failures;
+                    if (XdgIcon::fromTheme(name).isNull())
+                        ++failures;
+                }
+                if (!XdgIconLoader::instance()->loadIcon(u"tst-missing"_s).entries.empty())
+                    ++failures;
+            }
+            --running;
+        });
+    }
+
+    running = threads.size();
+    for (QThread *thread : std::as_const(threads))
+        thread->start();
+
+    // Keep dropping the resolved icons from the GUI thread meanwhile
+    while (running > 0) {
+        XdgIconLoader::instance()->invalidateKey();
+        XdgIconLoader::instance()->loadIcon(names.first());
+        QCoreApplication::processEvents();
+    }
+
+    for (QThread *thread : std::as_const(threads))
+        QVERIFY(thread->wait());
+    qDeleteAll(threads);
+
+    QCOMPARE(failures.load(), 0);
+}
+
+void tst_xdgiconloader::testScalablePixmap()
+{
+    const QIcon icon = XdgIcon::fromTheme(u"tst-dash"_s);
+    const QList<QIcon::Mode> modes = {QIcon::Normal, QIcon::Disabled, QIcon::Active, QIcon::Selected};
+    for (QIcon::Mode mode : modes) {
+        QPixmapCache::clear();
+        const QPixmap pixmap = icon.pixmap(QSize(48, 48), 2.0, mode);
+        QCOMPARE(pixmap.size(), QSize(96, 96));
+        QCOMPARE(pixmap.devicePixelRatio(), 2.0);
+    }
+}
+
+void tst_xdgiconloader::testDiskCache()
+{
+    QDir cacheDir(QStandardPaths::writableLocation(QStandardPaths::GenericCacheLocation)
+                  + u"/qtxdg/icons"_s);
+    cacheDir.removeRecursively();
+
+    XdgIcon::setDiskCacheEnabled(true);
+    const QIcon icon = XdgIcon::fromTheme(u"tst-app2"_s);
+
+    QPixmapCache::clear();
+    const QImage rendered = icon.pixmap(QSize(24, 24), 1.0).toImage();
+    const QImage loaded = icon.pixmap(QSize(16, 16), 1.0).toImage();
+    QCOMPARE(cacheDir.entryList(QDir::Files).size(), 2);
+
+    // Both come from the disk cache now
+    QPixmapCache::clear();
+    QCOMPARE(icon.pixmap(QSize(24, 24), 1.0).toImage(), rendered);
+    QCOMPARE(icon.pixmap(QSize(16, 16), 1.0).toImage(), loaded);
+    QCOMPARE(cacheDir.entryList(QDir::Files).size(), 2);
+
+    // Each of them is over the limit
+    QCOMPARE(XdgIcon::diskCacheLimit(), 65536);
+    XdgIcon::setDiskCacheLimit(1);
+    QThreadPool::globalInstance()->waitForDone();
+    QCOMPARE(cacheDir.entryList(QDir::Files).size(), 0);
+    XdgIcon::setDiskCacheLimit(65536);
+
+    XdgIcon::setDiskCacheEnabled(false);
+    cacheDir.removeRecursively();
+}
+
+void tst_xdgiconloader::testImageCacheLimit()
+{
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    const int limit = loader->imageCacheLimit();
+    QCOMPARE(limit, 8192);
+
+    // Images that don't fit are decoded again when needed
+    loader->setImageCacheLimit(0);
+    const QIcon icon = XdgIcon::fromTheme(u"tst-app3"_s);
+    const QIcon other = XdgIcon::fromTheme(u"tst-app5"_s);
+    for (int i = 0; i < 2; ++i) {
+        QPixmapCache::clear();
+        QCOMPARE(icon.pixmap(QSize(32, 32), 1.0).size(), QSize(32, 32));
+        QCOMPARE(other.pixmap(QSize(16, 16), 1.0).size(), QSize(16, 16));
+    }
+    loader->setImageCacheLimit(limit);
+}
+
+void tst_xdgiconloader::testFromThemeBatch()
+{
+    const QIcon fallback = XdgIcon::fromTheme(u"tst-dash"_s);
+    const QStringList names = {u"tst-app4"_s, u"tst-missing"_s, u"tst-app5.png"_s, QString()};
+    const QList<QIcon> icons = XdgIcon::fromThemeBatch(names, fallback);
+    QCOMPARE(icons.size(), names.size());
+    QCOMPARE(icons.at(0).name(), u"tst-app4"_s);
+    QCOMPARE(icons.at(1).name(), u"tst-dash"_s);
+    QCOMPARE(icons.at(2).name(), u"tst-app5"_s);
+    QCOMPARE(icons.at(3).name(), u"tst-dash"_s);
+}
+
+void tst_xdgiconloader::testLazyFallback()
+{
+    const QIcon fallback = XdgIcon::fromTheme(u"tst-dash"_s);
+
+    const QIcon missing = XdgIcon::fromTheme(u"tst-missing"_s, fallback);
+    QVERIFY(!missing.isNull());
+    QCOMPARE(missing.name(), u"tst-dash"_s);
+    QCOMPARE(missing.pixmap(QSize(24, 24), 1.0).size(), QSize(24, 24));
+
+    const QIcon found = XdgIcon::fromTheme(u"tst-app6"_s, fallback);
+    QCOMPARE(found.name(), u"tst-app6"_s);
+
+    const QStringList names = {u"tst-missing"_s, u"tst-app7"_s, u"tst-app8"_s};
+    QCOMPARE(XdgIcon::fromTheme(names).name(), u"tst-app7"_s);
+    QCOMPARE(XdgIcon::fromTheme(names, fallback).name(), u"tst-app7"_s);
+
+    const QStringList missingNames = {u"tst-missing"_s, u"tst-missing2"_s};
+    QVERIFY(XdgIcon::fromTheme(missingNames).isNull());
+    QCOMPARE(XdgIcon::fromTheme(missingNames, fallback).name(), u"tst-dash"_s);
+
+    // Serialized as the icon chosen, which the plugin reads back
+    const auto serialized = [] (const QIcon &icon) {
+        QByteArray data;
+        QDataStream out(&data, QIODevice::WriteOnly);
+        out << icon;
+        return data;
+    };
+    QCOMPARE(serialized(missing), serialized(fallback));
+    QCOMPARE(serialized(found), serialized(XdgIcon::fromTheme(u"tst-app6"_s)));
+}
+
+void tst_xdgiconloader::testIconCacheLimit()
+{
+    const int limit = XdgIcon::cacheLimit();
+    QCOMPARE(limit, 512);
+
+    // Nothing fits, every call creates a new icon
+    XdgIcon::setCacheLimit(0);
+    const QIcon icon = XdgIcon::fromTheme(u"tst-app9"_s);
+    QVERIFY(!icon.isNull());
+    QVERIFY(XdgIcon::fromTheme(u"tst-app9"_s).cacheKey() != icon.cacheKey());
+
+    XdgIcon::setCacheLimit(limit);
+    const QIcon cached = XdgIcon::fromTheme(u"tst-app9"_s);
+    QCOMPARE(XdgIcon::fromTheme(u"tst-app9"_s).cacheKey(), cached.cacheKey());
+}
+
+void tst_xdgiconloader::testContentDirInvalidation()
+{
+    QIcon::setThemeName(u"tst-child"_s);
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    const QString childDir = m_iconsDir.filePath(u"tst-child"_s);
+
+    QThemeIconInfo info = loader->loadIcon(u"tst-app3"_s);
+    QCOMPARE(int(info.entries.size()), 2);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-theme/"_s));
+
+    const uint generation = loader->generation();
+    loader->invalidateContentDir(m_iconsDir.filePath(u"tst-theme"_s));
+    QCOMPARE(loader->generation(), generation + 1);
+    // Not searched by the current theme
+    loader->invalidateContentDir(m_iconsDir.filePath(u"tst-big"_s));
+    QCOMPARE(loader->generation(), generation + 1);
+
+    // An icon added to the child shadows the one of the parent
+    const QString childFile = childDir + u"/scalable/apps/tst-app3.svg"_s;
+    QVERIFY(writeFile(childFile, svgIcon));
+    loader->invalidateContentDir(childDir);
+    info = loader->loadIcon(u"tst-app3"_s);
+    QCOMPARE(int(info.entries.size()), 1);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-child/"_s));
+
+    QVERIFY(QFile::remove(childFile));
+    loader->invalidateContentDir(childDir);
+    info = loader->loadIcon(u"tst-app3"_s);
+    QCOMPARE(int(info.entries.size()), 2);
+    QVERIFY(info.entries.front()->filename.contains(u"/tst-theme/"_s));
+
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::testLateIcon()
+{
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    const QString themeDir = m_iconsDir.filePath(u"tst-theme"_s);
+    const QString file = themeDir + u"/scalable/apps/tst-late.svg"_s;
+
+    QVERIFY(loader->loadIcon(u"tst-late"_s).entries.empty());
+    QCOMPARE(loader->resolveFirst({u"tst-late"_s}), -1);
+
+    // The miss is forgotten once the theme directory changed
+    QVERIFY(writeFile(file, svgIcon));
+    loader->invalidateContentDir(themeDir);
+    QCOMPARE(loader->loadIcon(u"tst-late"_s).iconName, u"tst-late"_s);
+    QCOMPARE(loader->resolveFirst({u"tst-late"_s}), 0);
+
+    QVERIFY(QFile::remove(file));
+    loader->invalidateContentDir(themeDir);
+    QVERIFY(loader->loadIcon(u"tst-late"_s).entries.empty());
+}
+
+void tst_xdgiconloader::testWorkerFirst()
+{
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    QCOMPARE(int(loader->loadIcon(u"tst-app0"_s).entries.size()), 3);
+    QIcon::setThemeName(u"tst-child"_s);
+
+    // The worker sees the theme change once the GUI thread saw it
+    XdgIconLoaderEngine engine(u"tst-dash-more"_s);
+    QString iconName;
+    QThread *thread = QThread::create([&engine, &iconName] { iconName = engine.iconName(); });
+    thread->start();
+    QVERIFY(thread->wait());
+    delete thread;
+    QCOMPARE(iconName, u"tst-dash"_s);
+
+    QCOMPARE(int(loader->loadIcon(u"tst-app0"_s).entries.size()), 1);
+    thread = QThread::create([&engine, &iconName] { iconName = engine.iconName(); });
+    thread->start();
+    QVERIFY(thread->wait());
+    delete thread;
+    QCOMPARE(iconName, u"tst-dash-more"_s);
+
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::testThemeSwitchPixmaps()
+{
+    const QString file = m_iconsDir.filePath(u"tst-theme/scalable/apps/tst-switch.svg"_s);
+    QVERIFY(writeFile(file, svgIcon));
+    QCOMPARE(XdgIcon::fromTheme(u"tst-switch"_s).pixmap(QSize(20, 20), 1.0).toImage().pixel(10, 10),
+             qRgb(255, 0, 0));
+
+    // The file changed unnoticed, switching the themes renders it again
+    QVERIFY(writeFile(file, QByteArray(svgIcon).replace("#ff0000", "#00ff00")));
+    QIcon::setThemeName(u"tst-child"_s);
+    QIcon::setThemeName(u"tst-theme"_s);
+    QCOMPARE(XdgIcon::fromTheme(u"tst-switch"_s).pixmap(QSize(20, 20), 1.0).toImage().pixel(10, 10),
+             qRgb(0, 255, 0));
+    QVERIFY(QFile::remove(file));
+}
+
+void tst_xdgiconloader::testGtkCache()
+{
+    const QString themeDir = m_iconsDir.filePath(u"tst-gtk"_s);
+    const QStringList dirs = {u"16x16/apps"_s, u"32x32/apps"_s};
+    for (const QString &dir : dirs) {
+        QVERIFY(QDir().mkpath(themeDir + u'/' + dir));
+        QVERIFY(writePng(themeDir + u'/' + dir + u"/tst-gtk-app.png"_s, 16));
+    }
+    QVERIFY(writeFile(themeDir + u"/index.theme"_s, gtkIndexTheme));
+    // The cache knows of one file only, the other one isn't looked for
+    const QString cacheFile = themeDir + u"/icon-theme.cache"_s;
+    QVERIFY(writeGtkCache(cacheFile, gtkIconCache(u"tst-gtk-app"_s, dirs, {0})));
+
+    QIcon::setThemeName(u"tst-gtk"_s);
+    XdgIconLoader *loader = XdgIconLoader::instance();
+    QThemeIconInfo info = loader->loadIcon(u"tst-gtk-app"_s);
+    QCOMPARE(int(info.entries.size()), 1);
+    QVERIFY(info.entries.front()->filename.contains(u"/16x16/"_s));
+
+    // Rewritten in place, the theme directory doesn't change
+    QVERIFY(writeGtkCache(cacheFile, gtkIconCache(u"tst-gtk-app"_s, dirs, {0, 1})));
+    QTRY_COMPARE(int(loader->loadIcon(u"tst-gtk-app"_s).entries.size()), 2);
+
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::benchmarkScalablePixmap_data()
+{
+    QTest::addColumn<int>("mode");
+    QTest::newRow("normal") << int(QIcon::Normal);
+    QTest::newRow("disabled") << int(QIcon::Disabled);
+}
+
+void tst_xdgiconloader::benchmarkScalablePixmap()
+{
+    QFETCH(int, mode);
+    const QIcon icon = XdgIcon::fromTheme(u"tst-dash"_s);
+
+    // Every iteration misses QPixmapCache and rasterizes the SVG
+    QBENCHMARK {
+        QPixmapCache::clear();
+        icon.pixmap(QSize(64, 64), 1.0, QIcon::Mode(mode));
+    }
+}
+
+void tst_xdgiconloader::benchmarkCachedPixmap()
+{
+    const QIcon pixmapIcon = XdgIcon::fromTheme(u"tst-app1"_s);
+    const QIcon scalableIcon = XdgIcon::fromTheme(u"tst-dash"_s);
+    pixmapIcon.pixmap(QSize(16, 16), 1.0);
+    scalableIcon.pixmap(QSize(24, 24), 1.0);
+
+    // Both pixmaps are found in the cache
+    QBENCHMARK {
+        pixmapIcon.pixmap(QSize(16, 16), 1.0);
+        scalableIcon.pixmap(QSize(24, 24), 1.0);
+    }
+}
+
+void tst_xdgiconloader::benchmarkSizeSelection()
+{
+    const QIcon icon = XdgIcon::fromTheme(u"tst-app0"_s);
+    QCOMPARE(icon.actualSize(QSize(16, 16)), QSize(16, 16));
+    QCOMPARE(icon.actualSize(QSize(24, 24)), QSize(24, 24));
+
+    // What a view does while laying out and painting its items
+    QBENCHMARK {
+        for (int i = 0; i < 10000; ++i) {
+            const QSize size(16 << (i % 2), 16 << (i % 2));
+            icon.actualSize(size);
+            icon.pixmap(size, 1.0);
+        }
+    }
+}
+
+void tst_xdgiconloader::benchmarkFromTheme_data()
+{
+    QTest::addColumn<bool>("batch");
+    QTest::newRow("loop") << false;
+    QTest::newRow("batch") << true;
+}
+
+void tst_xdgiconloader::benchmarkFromTheme()
+{
+    QFETCH(bool, batch);
+
+    // Like an application menu, with some icons missing in the theme
+    QStringList names;
+    for (int i = 0; i < 2000; ++i)
+        names << (i % 4 == 3 ? u"tst-missing%1"_s.arg(i) : m_iconNames.at(i % m_iconNames.size()) + u"-%1"_s.arg(i));
+
+    QBENCHMARK {
+        // Resolve from scratch every time
+        XdgIconLoader::instance()->invalidateKey();
+        if (batch) {
+            XdgIcon::fromThemeBatch(names);
+        } else {
+            for (const QString &name : std::as_const(names))
+                XdgIcon::fromTheme(name);
+        }
+    }
+}
+
+void tst_xdgiconloader::benchmarkThemeSwitch()
+{
+    // Themes are only parsed once per process, so only the first switch to
+    // a theme can be measured
+    QBENCHMARK_ONCE {
+        QIcon::setThemeName(u"tst-big"_s);
+        QVERIFY(!XdgIconLoader::instance()->loadIcon(u"tst-app0"_s).entries.empty());
+    }
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+void tst_xdgiconloader::benchmarkGtkCacheLookup_data()
+{
+    QTest::addColumn<QString>("themeName");
+    QTest::newRow("Adwaita") << u"Adwaita"_s;
+    QTest::newRow("breeze") << u"breeze"_s;
+}
+
+void tst_xdgiconloader::benchmarkGtkCacheLookup()
+{
+    QFETCH(QString, themeName);
+
+    // The real caches, as generated by gtk-update-icon-cache
+    const QString themeDir = u"/usr/share/icons/"_s + themeName;
+    if (!QFile::exists(themeDir + u"/icon-theme.cache"_s))
+        QSKIP("The theme or its icon-theme.cache isn't installed");
+
+    QIcon::setThemeSearchPaths(QStringList() << u"/usr/share/icons"_s);
+    QIcon::setThemeName(themeName);
+    XdgIconLoader *loader = XdgIconLoader::instance();
+
+    // The names and their dash fallbacks are all looked up in the cache,
+    // only the directories it lists are checked on disk
+    const QStringList names = {
+        u"document-open-recent-qtxdg"_s, u"edit-copy-qtxdg"_s, u"folder-qtxdg"_s,
+        u"user-trash-full-qtxdg"_s, u"media-playback-start-qtxdg"_s,
+        u"application-x-qtxdg-missing"_s, u"qtxdg-missing-icon-name"_s,
+    };
+    QBENCHMARK {
+        loader->invalidateContentDir(themeDir);
+        for (const QString &name : names)
+            loader->loadIcon(name);
+    }
+
+    QIcon::setThemeSearchPaths(QStringList() << m_iconsDir.path());
+    QIcon::setThemeName(u"tst-theme"_s);
+}
+
+QTEST_MAIN(tst_xdgiconloader)
+#include "tst_xdgiconloader.moc"
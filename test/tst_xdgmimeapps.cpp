@@ -0,0 +1,387 @@
+/*
+ * libqtxdg - An Qt implementation of freedesktop.org xdg specs
+ * Copyright (C) 2026  LXQt team
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA  02110-1301  USA
+ */
+
+#include "xdgdefaultapps.h"
+#include "xdgdesktopfile.h"
+#include "xdgmimeapps.h"
+
+#include <QDir>
+#include <QFile>
+#include <QSettings>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include <memory>
+
+using namespace Qt::Literals::StringLiterals;
+
+class tst_xdgmimeapps : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testQueries();
+    void testMaskedAndHidden();
+    void testCompareBackends_data();
+    void testCompareBackends();
+    void testEntries();
+    void testCategories();
+    void testDefaultTerminal();
+    void testDefaultWebBrowser();
+    void testChangeAssociations();
+    void testSharedBackend();
+    void testAppsChanged();
+    void testAppsChangedGLib();
+
+private:
+    bool writeFile(const QString &fileName, const QByteArray &data);
+    bool writeApp(const QString &fileName, const QByteArray &mimeTypes, const QByteArray &extra = QByteArray());
+    static QStringList ids(const QList<XdgDesktopFile *> &apps);
+    static QStringList ids(const XdgDesktopFileList &apps);
+
+    QTemporaryDir m_dir;
+};
+
+bool tst_xdgmimeapps::writeFile(const QString &fileName, const QByteArray &data)
+{
+    if (!QDir().mkpath(QFileInfo(fileName).path()))
+        return false;
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+bool tst_xdgmimeapps::writeApp(const QString &fileName, const QByteArray &mimeTypes, const QByteArray &extra)
+{
+    return writeFile(fileName,
+                     "[Desktop Entry]\nType=Application\nName=" + QFileInfo(fileName).baseName().toUtf8()
+                     + "\nExec=true %U\nMimeType=" + mimeTypes + '\n' + extra);
+}
+
+// The sorted desktop ids of apps, which are deleted
+QStringList tst_xdgmimeapps::ids(const QList<XdgDesktopFile *> &apps)
+{
+    QStringList result;
+    for (XdgDesktopFile *app : apps) {
+        result.append(XdgDesktopFile::id(app->fileName()));
+        delete app;
+    }
+    result.sort();
+    return result;
+}
+
+QStringList tst_xdgmimeapps::ids(const XdgDesktopFileList &apps)
+{
+    QStringList result;
+    for (const XdgDesktopFile &app : apps)
+        result.append(XdgDesktopFile::id(app.fileName()));
+    result.sort();
+    return result;
+}
+
+void tst_xdgmimeapps::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+
+    // The environment must be set before GIO reads it
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(m_dir.filePath(u"config"_s)));
+    qputenv("XDG_CONFIG_DIRS", QFile::encodeName(m_dir.filePath(u"xdg"_s)));
+    qputenv("XDG_DATA_HOME", QFile::encodeName(m_dir.filePath(u"data"_s)));
+    qputenv("XDG_DATA_DIRS", QFile::encodeName(m_dir.filePath(u"sys"_s)));
+    qputenv("XDG_CURRENT_DESKTOP", "TST");
+    // XdgDefaultApps asks GIO
+    qputenv("QTXDG_MIMEAPPS_BACKEND", "glib");
+
+    // Both backends need the same MIME database for the parent types
+    QVERIFY(QDir().mkpath(m_dir.filePath(u"sys"_s)));
+    if (QFileInfo::exists(u"/usr/share/mime"_s))
+        QVERIFY(QFile::link(u"/usr/share/mime"_s, m_dir.filePath(u"sys/mime"_s)));
+
+    const QString user = m_dir.filePath(u"data/applications/"_s);
+    const QString sys = m_dir.filePath(u"sys/applications/"_s);
+    QVERIFY(writeApp(user + u"tst-user.desktop"_s, "application/x-qtxdg-test;", "Categories=X-QtXdgTest;\n"));
+    QVERIFY(writeApp(user + u"tst-masked.desktop"_s, "application/x-qtxdg-other;"));
+    QVERIFY(writeFile(user + u"mimeinfo.cache"_s,
+                      "[MIME Cache]\n"
+                      "application/x-qtxdg-test=tst-user.desktop;\n"
+                      "application/x-qtxdg-other=tst-masked.desktop;\n"));
+
+    QVERIFY(writeApp(sys + u"tst-viewer.desktop"_s, "application/x-qtxdg-test;", "Categories=Graphics;Viewer;\n"));
+    QVERIFY(writeApp(sys + u"tst-editor.desktop"_s, "application/x-qtxdg-test;text/plain;",
+                     "Categories=Utility;QtXdgTest;X-QtXdgTest;TextEditor;\n"));
+    QVERIFY(writeApp(sys + u"tst-browser.desktop"_s, "x-scheme-handler/qtxdg;"));
+    QVERIFY(writeApp(sys + u"kde/tst-sub.desktop"_s, "text/x-csrc;"));
+    QVERIFY(writeApp(sys + u"tst-masked.desktop"_s, "application/x-qtxdg-test;"));
+    QVERIFY(writeApp(sys + u"tst-term.desktop"_s, "", "Categories=System;TerminalEmulator;\n"));
+    QVERIFY(writeApp(sys + u"tst-hidden.desktop"_s, "application/x-qtxdg-test;", "Hidden=true\n"));
+    QVERIFY(writeFile(sys + u"mimeinfo.cache"_s,
+                      "[MIME Cache]\n"
+                      "application/x-qtxdg-test=tst-viewer.desktop;tst-editor.desktop;tst-masked.desktop;tst-hidden.desktop;\n"
+                      "text/plain=tst-editor.desktop;\n"
+                      "text/x-csrc=kde-tst-sub.desktop;\n"
+                      "x-scheme-handler/qtxdg=tst-browser.desktop;\n"));
+    QVERIFY(writeFile(sys + u"defaults.list"_s,
+                      "[Default Applications]\n"
+                      "text/plain=tst-editor.desktop\n"));
+
+    QVERIFY(writeFile(m_dir.filePath(u"config/mimeapps.list"_s),
+                      "[Removed Associations]\n"
+                      "application/x-qtxdg-test=tst-editor.desktop;\n"));
+    QVERIFY(writeFile(m_dir.filePath(u"xdg/tst-mimeapps.list"_s),
+                      "[Default Applications]\n"
+                      "x-scheme-handler/qtxdg=tst-browser.desktop\n"));
+}
+
+void tst_xdgmimeapps::testQueries()
+{
+    XdgMimeApps db(XdgMimeApps::NativeBackend);
+
+    QCOMPARE(ids(db.recommendedApps(u"application/x-qtxdg-test"_s)),
+             QStringList({u"tst-user.desktop"_s, u"tst-viewer.desktop"_s}));
+
+    std::unique_ptr<XdgDesktopFile> app(db.defaultApp(u"x-scheme-handler/qtxdg"_s));
+    QVERIFY(app);
+    QCOMPARE(XdgDesktopFile::id(app->fileName()), u"tst-browser.desktop"_s);
+
+    app.reset(db.defaultApp(u"x-scheme-handler/none"_s));
+    QVERIFY(!app);
+}
+
+void tst_xdgmimeapps::testMaskedAndHidden()
+{
+    XdgMimeApps db(XdgMimeApps::NativeBackend);
+
+    // The user's tst-masked.desktop hides the one of the system and its
+    // associations
+    const QStringList all = ids(db.allApps());
+    QVERIFY(all.contains(u"tst-masked.desktop"_s));
+    QVERIFY(all.contains(u"kde-tst-sub.desktop"_s));
+    QVERIFY(!all.contains(u"tst-hidden.desktop"_s));
+    QVERIFY(!ids(db.apps(u"application/x-qtxdg-test"_s)).contains(u"tst-masked.desktop"_s));
+}
+
+void tst_xdgmimeapps::testCompareBackends_data()
+{
+    QTest::addColumn<QString>("mimeType");
+    QTest::newRow("custom") << u"application/x-qtxdg-test"_s;
+    QTest::newRow("masked") << u"application/x-qtxdg-other"_s;
+    QTest::newRow("scheme") << u"x-scheme-handler/qtxdg"_s;
+    QTest::newRow("plain") << u"text/plain"_s;
+    QTest::newRow("subclass") << u"text/x-csrc"_s;
+    QTest::newRow("unknown") << u"application/x-qtxdg-none"_s;
+}
+
+void tst_xdgmimeapps::testCompareBackends()
+{
+    QFETCH(QString, mimeType);
+
+    XdgMimeApps glib(XdgMimeApps::GLibBackend);
+    XdgMimeApps native(XdgMimeApps::NativeBackend);
+
+    QCOMPARE(ids(native.apps(mimeType)), ids(glib.apps(mimeType)));
+    QCOMPARE(ids(native.recommendedApps(mimeType)), ids(glib.recommendedApps(mimeType)));
+    QCOMPARE(ids(native.fallbackApps(mimeType)), ids(glib.fallbackApps(mimeType)));
+
+    std::unique_ptr<XdgDesktopFile> nativeDefault(native.defaultApp(mimeType));
+    std::unique_ptr<XdgDesktopFile> glibDefault(glib.defaultApp(mimeType));
+    QCOMPARE(bool(nativeDefault), bool(glibDefault));
+    if (nativeDefault)
+        QCOMPARE(XdgDesktopFile::id(nativeDefault->fileName()), XdgDesktopFile::id(glibDefault->fileName()));
+
+    QCOMPARE(ids(native.allApps()), ids(glib.allApps()));
+}
+
+void tst_xdgmimeapps::testEntries()
+{
+    XdgMimeApps db(XdgMimeApps::NativeBackend);
+    const QString mimeType = u"application/x-qtxdg-test"_s;
+
+    // The same answers as the owning variants, query after query
+    for (int i = 0; i < 2; ++i) {
+        QCOMPARE(ids(db.allAppEntries()), ids(db.allApps()));
+        QCOMPARE(ids(db.appEntries(mimeType)), ids(db.apps(mimeType)));
+        QCOMPARE(ids(db.recommendedAppEntries(mimeType)), ids(db.recommendedApps(mimeType)));
+        QCOMPARE(ids(db.fallbackAppEntries(u"text/x-csrc"_s)), ids(db.fallbackApps(u"text/x-csrc"_s)));
+    }
+
+    const XdgDesktopFile app = db.defaultAppEntry(u"x-scheme-handler/qtxdg"_s);
+    QVERIFY(app.isValid());
+    QCOMPARE(XdgDesktopFile::id(app.fileName()), u"tst-browser.desktop"_s);
+    QVERIFY(!db.defaultAppEntry(u"x-scheme-handler/none"_s).isValid());
+}
+
+void tst_xdgmimeapps::testCategories()
+{
+    XdgMimeApps glib(XdgMimeApps::GLibBackend);
+    XdgMimeApps native(XdgMimeApps::NativeBackend);
+
+    const QStringList both({u"tst-editor.desktop"_s, u"tst-user.desktop"_s});
+    for (XdgMimeApps *db : {&glib, &native}) {
+        QCOMPARE(ids(db->categoryAppEntries(u"QtXdgTest"_s)), both);
+        QCOMPARE(ids(db->categoryAppEntries(u"x-qtxdgtest"_s)), both);
+        QCOMPARE(ids(db->categoryApps(u"viewer"_s)), QStringList(u"tst-viewer.desktop"_s));
+        QVERIFY(db->categoryAppEntries(u"Qt"_s).isEmpty());
+    }
+}
+
+void tst_xdgmimeapps::testDefaultTerminal()
+{
+    const auto terminalId = [] {
+        std::unique_ptr<XdgDesktopFile> terminal(XdgDefaultApps::terminal());
+        return terminal ? XdgDesktopFile::id(terminal->fileName()) : QString();
+    };
+
+    QVERIFY(ids(XdgDefaultApps::terminals()).contains(u"tst-term.desktop"_s));
+    QCOMPARE(terminalId(), QString());
+
+    XdgDesktopFile term;
+    QVERIFY(term.load(m_dir.filePath(u"sys/applications/tst-term.desktop"_s)));
+    QVERIFY(XdgDefaultApps::setTerminal(term));
+    QCOMPARE(terminalId(), u"tst-term.desktop"_s);
+
+    // Remembered until the configuration changes
+    const QString configFile = QSettings(QSettings::UserScope, u"tst-qtxdg"_s).fileName();
+    QVERIFY(writeFile(configFile, "[General]\nTerminalEmulator=tst-none.desktop\n"));
+    QTRY_COMPARE(terminalId(), QString());
+}
+
+void tst_xdgmimeapps::testDefaultWebBrowser()
+{
+    const auto browserId = [] {
+        std::unique_ptr<XdgDesktopFile> browser(XdgDefaultApps::webBrowser());
+        return browser ? XdgDesktopFile::id(browser->fileName()) : QString();
+    };
+
+    XdgDesktopFile browser;
+    QVERIFY(browser.load(m_dir.filePath(u"sys/applications/tst-browser.desktop"_s)));
+    QCOMPARE(browserId(), QString());
+    QVERIFY(XdgDefaultApps::setWebBrowser(browser));
+    // Until GIO reads the lists again it answers as before, that answer
+    // isn't kept
+    QTRY_COMPARE(browserId(), u"tst-browser.desktop"_s);
+}
+
+void tst_xdgmimeapps::testChangeAssociations()
+{
+    XdgMimeApps db(XdgMimeApps::NativeBackend);
+    const QString mimeType = u"application/x-qtxdg-test"_s;
+
+    XdgDesktopFile viewer;
+    QVERIFY(viewer.load(m_dir.filePath(u"sys/applications/tst-viewer.desktop"_s)));
+    QVERIFY(db.setDefaultApp(mimeType, viewer));
+    std::unique_ptr<XdgDesktopFile> app(db.defaultApp(mimeType));
+    QVERIFY(app);
+    QCOMPARE(XdgDesktopFile::id(app->fileName()), u"tst-viewer.desktop"_s);
+
+    QVERIFY(db.removeSupport(mimeType, viewer));
+    QVERIFY(!ids(db.recommendedApps(mimeType)).contains(u"tst-viewer.desktop"_s));
+
+    // The removal of tst-editor.desktop is reset too
+    QVERIFY(db.reset(mimeType));
+    const QStringList recommended = ids(db.recommendedApps(mimeType));
+    QVERIFY(recommended.contains(u"tst-viewer.desktop"_s));
+    QVERIFY(recommended.contains(u"tst-editor.desktop"_s));
+}
+
+void tst_xdgmimeapps::testSharedBackend()
+{
+    XdgMimeApps first(XdgMimeApps::NativeBackend);
+    QVERIFY(!first.allAppEntries().isEmpty());
+    {
+        // The last user of the backend isn't this one
+        XdgMimeApps other(XdgMimeApps::NativeBackend);
+        QCOMPARE(ids(other.allAppEntries()), ids(first.allAppEntries()));
+    }
+
+    XdgMimeApps second(XdgMimeApps::NativeBackend);
+    QSignalSpy firstSpy(&first, &XdgMimeApps::changed);
+    QSignalSpy secondSpy(&second, &XdgMimeApps::changed);
+
+    // Every object is notified of a change made through one of them
+    XdgDesktopFile viewer;
+    QVERIFY(viewer.load(m_dir.filePath(u"sys/applications/tst-viewer.desktop"_s)));
+    QVERIFY(second.addSupport(u"application/x-qtxdg-other"_s, viewer));
+    QVERIFY(ids(first.appEntries(u"application/x-qtxdg-other"_s)).contains(u"tst-viewer.desktop"_s));
+    QTRY_VERIFY(!firstSpy.isEmpty() && !secondSpy.isEmpty());
+}
+
+void tst_xdgmimeapps::testAppsChanged()
+{
+    XdgMimeApps db(XdgMimeApps::NativeBackend);
+    QSignalSpy spy(&db, &XdgMimeApps::appsChanged);
+    QSignalSpy changedSpy(&db, &XdgMimeApps::changed);
+
+    XdgDesktopFile viewer;
+    QVERIFY(viewer.load(m_dir.filePath(u"sys/applications/tst-viewer.desktop"_s)));
+    QVERIFY(db.addSupport(u"application/x-qtxdg-added"_s, viewer));
+    QCOMPARE(spy.size(), 1);
+    QList<QVariant> args = spy.takeFirst();
+    QVERIFY(args.at(0).toStringList().isEmpty());
+    QVERIFY(args.at(1).toStringList().isEmpty());
+    QVERIFY(args.at(2).toStringList().isEmpty());
+    QCOMPARE(args.at(3).toStringList(), QStringList(u"application/x-qtxdg-added"_s));
+    // The watcher doesn't report the same change again
+    QTest::qWait(500);
+    QCOMPARE(changedSpy.size(), 1);
+
+    // Found by the watcher
+    QVERIFY(writeApp(m_dir.filePath(u"data/applications/tst-new.desktop"_s), "application/x-qtxdg-new;"));
+    QTRY_VERIFY(!spy.isEmpty());
+    args = spy.takeFirst();
+    QCOMPARE(args.at(0).toStringList(), QStringList(u"tst-new.desktop"_s));
+    QVERIFY(args.at(1).toStringList().isEmpty());
+    QVERIFY(args.at(3).toStringList().contains(u"application/x-qtxdg-new"_s));
+
+    QVERIFY(QFile::remove(m_dir.filePath(u"data/applications/tst-new.desktop"_s)));
+    QTRY_VERIFY(!spy.isEmpty());
+    args = spy.takeFirst();
+    QCOMPARE(args.at(1).toStringList(), QStringList(u"tst-new.desktop"_s));
+}
+
+void tst_xdgmimeapps::testAppsChangedGLib()
+{
+    XdgMimeApps db(XdgMimeApps::GLibBackend);
+    QSignalSpy spy(&db, &XdgMimeApps::appsChanged);
+    QSignalSpy changedSpy(&db, &XdgMimeApps::changed);
+    const QString mimeType = u"application/x-qtxdg-glib"_s;
+
+    // The types of the changed list sections are reported
+    QVERIFY(db.appEntries(mimeType).isEmpty());
+    XdgDesktopFile viewer;
+    QVERIFY(viewer.load(m_dir.filePath(u"sys/applications/tst-viewer.desktop"_s)));
+    QVERIFY(db.addSupport(mimeType, viewer));
+    QVERIFY(!spy.isEmpty());
+    QVERIFY(spy.first().at(3).toStringList().contains(mimeType));
+    QTRY_VERIFY(ids(db.appEntries(mimeType)).contains(u"tst-viewer.desktop"_s));
+
+    // The default asked before GIO reads the list again isn't kept
+    XdgDesktopFile editor;
+    QVERIFY(editor.load(m_dir.filePath(u"sys/applications/tst-editor.desktop"_s)));
+    changedSpy.clear();
+    QVERIFY(db.setDefaultApp(mimeType, editor));
+    QVERIFY(!changedSpy.isEmpty());
+    db.defaultAppEntry(mimeType);
+    QTRY_COMPARE(XdgDesktopFile::id(db.defaultAppEntry(mimeType).fileName()), u"tst-editor.desktop"_s);
+}
+
+QTEST_GUILESS_MAIN(tst_xdgmimeapps)
+#include "tst_xdgmimeapps.moc"